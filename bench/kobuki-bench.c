@@ -0,0 +1,476 @@
+#define _GNU_SOURCE // sched_setaffinity()
+// C library headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+// User headers
+#include "kobuki.h"
+
+#define BENCH_REPS_DEFAULT 15
+#define BENCH_MIN_TIME_MS_DEFAULT 20
+#define BENCH_NAME_MAX_LEN 64
+
+/**
+ * @brief Benchmark case
+ */
+struct BenchCase
+{
+  char name[BENCH_NAME_MAX_LEN];
+  void (*run)(void *arg);
+  void *arg;
+};
+
+/**
+ * @brief Benchmark options
+ */
+struct BenchOption
+{
+  int reps;
+  int min_time_ms;
+  int cpu; ///< -1: CPU 고정 안함
+  const char *filter;
+};
+
+static FILE *g_json; ///< 결과 출력 (stdout 은 /dev/null 로 보낸다)
+static int g_sink_socket = -1;
+static const char g_sample_script[] =
+  "# sample script\n"
+  "led 1 2\n"
+  "sleep 100\n"
+  "speed 3 0 0 1\n"
+  "sleep 500\n"
+  "speed 2 500 90 0\n"
+  "speed -2 -500 90 0\n"
+  "speed 1 1 180 0\n"
+  "led 2 1\n"
+  "sleep 1000\n"
+  "#speed 100 -1\n"
+  "speed 3 0 0 0.5\n";
+static uint8_t g_feedback_packet[64];
+static size_t g_feedback_packet_len;
+static uint8_t g_bumper_frame[2][64]; ///< bumper 해제, 눌림 feedback frame
+static size_t g_bumper_frame_len;
+static struct SharedRegion *g_shared;
+static char g_shared_name[SHARED_NAME_MAX_LEN];
+static pid_t g_shared_server = -1;
+
+static uint64_t GetBenchTimeNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int CompareDouble(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* benchmark cases */
+static void RunEncodeSpeed(void *arg)
+{
+  static int speed = 0;
+  uint8_t frame[SPEED_FRAME_LEN];
+  (void)arg;
+
+  KOBUKI_EncodeSpeed(frame, speed++ & 0xFF, 0);
+  __asm__ volatile("" : : "r"(frame) : "memory");
+}
+
+static void RunControlSpeed(void *arg)
+{
+  static int speed = 0;
+  (void)arg;
+
+  KOBUKI_ControlSpeed(g_mib.device, speed++ & 0xFF, 0);
+}
+
+static void RunControlLED(void *arg)
+{
+  static int color = 0;
+  (void)arg;
+
+  KOBUKI_ControlLED(g_mib.device, 1, color++ % 3);
+}
+
+static void RunParseScript(void *arg)
+{
+  (void)arg;
+
+  FILE *fp = fmemopen((void *)g_sample_script, sizeof(g_sample_script) - 1, "r");
+  ParseScriptStream(fp, &g_mib.profile, &g_mib.scripts[0]);
+  fclose(fp);
+}
+
+static void RunPrintLog(void *arg)
+{
+  MessageType msg_type = (MessageType)(intptr_t)arg;
+
+  PrintLog(msg_type, "bench message - speed: %d, radius: %d\n", 100, 0);
+}
+
+static void RunParseFeedback(void *arg)
+{
+  struct FeedbackStatus feedback;
+  (void)arg;
+
+  ParseFeedbackPacket(g_feedback_packet, g_feedback_packet_len, &feedback);
+  __asm__ volatile("" : : "r"(&feedback) : "memory");
+}
+
+static void RunReflex(void *arg)
+{
+  static int pressed = 0;
+  (void)arg;
+
+  /* 눌림, 해제를 번갈아 넣어 두 번에 한 번 stop 을 전송한다. */
+  pressed ^= 1;
+  g_mib.rx_monotonic_us = GetMonotonicTimeUs();
+  HandleFeedback(g_bumper_frame[pressed], g_bumper_frame_len, GetTimeUs());
+}
+
+static void RunTraceSpanOff(void *arg)
+{
+  (void)arg;
+
+  /* StartTrace() 전: 분기 하나의 비용 */
+  TRACE_BEGIN(trace_span);
+  __asm__ volatile("" : : : "memory");
+  TRACE_END_ID(trace_span, "bench", 0);
+}
+
+static void RunSharedRoundTrip(void *arg)
+{
+  static int speed = 0;
+  struct SharedCommand command;
+  struct SharedState state;
+  (void)arg;
+
+  memset(&command, 0x00, sizeof(command));
+  command.speed = speed++ & 0xFF;
+  uint32_t command_id = PublishSharedCommand(g_shared, &command);
+
+  /* driver 프로세스가 명령을 전송하고 snapshot 에 반영할 때까지 */
+  uint32_t seq = ReadSharedState(g_shared, &state);
+  while (state.applied_command_id != command_id) {
+    if (WaitSharedState(g_shared, seq, 1000) < 0) {
+      fprintf(stderr, "Timeout shared memory round trip - id: %u\n", command_id);
+      return;
+    }
+    seq = ReadSharedState(g_shared, &state);
+  }
+}
+
+/**
+ * @brief 공유 메모리 영역을 만들고 driver 역할의 프로세스를 fork 한다.
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ * @details 자식 프로세스는 driver 와 같은 경로(futex helper thread -> eventfd -> WaitEventUntil() ->
+ *          ApplySharedCommand())로 명령을 sink socket 에 전송한다.
+ */
+static int StartSharedServer(void)
+{
+  snprintf(g_shared_name, sizeof(g_shared_name), "/kobuki-bench-%d", (int)getpid());
+  if (OpenSharedRegion(g_shared_name, true, &g_shared) < 0) {
+    return -1;
+  }
+
+  g_shared_server = fork();
+  if (g_shared_server == 0) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    g_mib.shared = g_shared;
+    if (StartSharedNotify(g_shared, &g_mib.shared_event_fd) < 0) {
+      _exit(1);
+    }
+    UpdateSharedState();
+    while (true) {
+      int ret = WaitEventUntil(GetTimeUs() + SHARED_SERVE_INTERVAL_MS * 1000, kEventType_Shared);
+      if (ret > 0 && (ret & kEventType_Shared)) {
+        ApplySharedCommand();
+      }
+    }
+  }
+  if (g_shared_server < 0) {
+    return -1;
+  }
+
+  /* 자식 프로세스의 첫 snapshot 까지 대기 */
+  struct SharedState state;
+  uint32_t seq = ReadSharedState(g_shared, &state);
+  if (seq == 0 && WaitSharedState(g_shared, seq, 1000) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static void StopSharedServer(void)
+{
+  if (g_shared_server > 0) {
+    kill(g_shared_server, SIGKILL);
+    waitpid(g_shared_server, NULL, 0);
+  }
+  if (g_shared != NULL) {
+    CloseSharedRegion(g_shared, g_shared_name, true);
+  }
+}
+
+/**
+ * @brief bumper 해제, 눌림 상태의 basic sensor feedback frame 을 만든다.
+ */
+static void InitBumperFrame(void)
+{
+  for (int pressed = 0; pressed < 2; pressed++) {
+    uint8_t *frame = g_bumper_frame[pressed];
+    struct ReliableHeader header;
+    struct BasicSensorFormat basic;
+
+    memset(&header, 0x00, sizeof(header));
+    header.magic = RELIABLE_MAGIC;
+    header.frame_type = kFrameType_Feedback;
+    header.session = g_mib.reliable.session;
+    memcpy(frame, &header, sizeof(header));
+
+    memset(&basic, 0x00, sizeof(basic));
+    basic.bumper = pressed ? 0x02 : 0x00;
+    uint8_t *ptr = frame + sizeof(header);
+    *ptr++ = HEADER_0;
+    *ptr++ = HEADER_1;
+    *ptr++ = 2 + FEEDBACK_BASIC_SENSOR_LEN;
+    *ptr++ = FEEDBACK_BASIC_SENSOR_ID;
+    *ptr++ = FEEDBACK_BASIC_SENSOR_LEN;
+    memcpy(ptr, &basic, FEEDBACK_BASIC_SENSOR_LEN);
+    ptr += FEEDBACK_BASIC_SENSOR_LEN;
+    *ptr = KOBUKI_Checksum(frame + sizeof(header), ptr - (frame + sizeof(header)));
+    g_bumper_frame_len = ptr - frame + 1;
+  }
+  KOBUKI_EncodeSpeed(g_mib.stop_frame, 0, 0);
+  InitReflex(&g_mib.reflex, REFLEX_DEFAULT_MASK, 0);
+}
+
+/**
+ * @brief basic sensor + inertial sensor feedback 패킷을 만든다.
+ */
+static void InitFeedbackPacket(void)
+{
+  uint8_t *ptr = g_feedback_packet;
+  struct BasicSensorFormat basic;
+  struct InertialSensorFormat inertial;
+
+  memset(&basic, 0x00, sizeof(basic));
+  memset(&inertial, 0x00, sizeof(inertial));
+  basic.left_encoder = 1000;
+  basic.right_encoder = 1010;
+  basic.battery = 160;
+  inertial.angle = 9000;
+
+  *ptr++ = HEADER_0;
+  *ptr++ = HEADER_1;
+  *ptr++ = 2 + FEEDBACK_BASIC_SENSOR_LEN + 2 + FEEDBACK_INERTIAL_SENSOR_LEN;
+  *ptr++ = FEEDBACK_BASIC_SENSOR_ID;
+  *ptr++ = FEEDBACK_BASIC_SENSOR_LEN;
+  memcpy(ptr, &basic, FEEDBACK_BASIC_SENSOR_LEN);
+  ptr += FEEDBACK_BASIC_SENSOR_LEN;
+  *ptr++ = FEEDBACK_INERTIAL_SENSOR_ID;
+  *ptr++ = FEEDBACK_INERTIAL_SENSOR_LEN;
+  memcpy(ptr, &inertial, FEEDBACK_INERTIAL_SENSOR_LEN);
+  ptr += FEEDBACK_INERTIAL_SENSOR_LEN;
+  *ptr = KOBUKI_Checksum(g_feedback_packet, ptr - g_feedback_packet);
+  g_feedback_packet_len = ptr - g_feedback_packet + 1;
+}
+
+/**
+ * @brief loopback 에 sink socket 을 만들고 g_mib 의 전송 대상으로 설정한다.
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ */
+static int InitSink(void)
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+
+  g_sink_socket = socket(PF_INET, SOCK_DGRAM, 0);
+  if (g_sink_socket < 0) {
+    return -1;
+  }
+  memset(&addr, 0x00, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  if (bind(g_sink_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      getsockname(g_sink_socket, (struct sockaddr *)&addr, &addr_len) < 0) {
+    return -1;
+  }
+
+  if (InitUDP("127.0.0.1", ntohs(addr.sin_port), &g_mib.server_addr, &g_mib.socket) < 0) {
+    return -1;
+  }
+  InitReliable(&g_mib.reliable);
+  return 0;
+}
+
+/**
+ * @brief sink socket 에 쌓인 frame 을 버린다.
+ */
+static void DrainSink(void)
+{
+  char buf[UDP_PACKET_MAX_SIZE];
+
+  while (recv(g_sink_socket, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+  }
+}
+
+/**
+ * @brief benchmark case 하나를 실행하고 JSON 으로 출력한다.
+ * @param[in] bench benchmark case
+ * @param[in] option benchmark options
+ * @param[in] first 첫 번째 결과 여부
+ */
+static void RunBench(const struct BenchCase *bench, const struct BenchOption *option, bool first)
+{
+  double *ns_per_op = calloc(option->reps, sizeof(double));
+  uint64_t min_time_ns = (uint64_t)option->min_time_ms * 1000000;
+  long iterations = 1;
+
+  /* warm up 및 반복 횟수 결정: 한 번의 측정이 min_time_ms 이상 걸리도록 */
+  while (true) {
+    uint64_t start_ns = GetBenchTimeNs();
+    for (long i = 0; i < iterations; i++) {
+      bench->run(bench->arg);
+    }
+    DrainSink();
+    if (GetBenchTimeNs() - start_ns >= min_time_ns) {
+      break;
+    }
+    iterations *= 2;
+  }
+
+  for (int rep = 0; rep < option->reps; rep++) {
+    uint64_t start_ns = GetBenchTimeNs();
+    for (long i = 0; i < iterations; i++) {
+      bench->run(bench->arg);
+    }
+    uint64_t elapsed_ns = GetBenchTimeNs() - start_ns;
+    ns_per_op[rep] = (double)elapsed_ns / iterations;
+    DrainSink();
+  }
+  qsort(ns_per_op, option->reps, sizeof(double), CompareDouble);
+
+  fprintf(g_json, "%s\n    {\"name\": \"%s\", \"iterations\": %ld, \"reps\": %d, "
+          "\"ns_per_op_median\": %.1f, \"ns_per_op_min\": %.1f, \"ns_per_op_max\": %.1f}",
+          first ? "" : ",", bench->name, iterations, option->reps,
+          ns_per_op[option->reps / 2], ns_per_op[0], ns_per_op[option->reps - 1]);
+  fflush(g_json);
+  free(ns_per_op);
+}
+
+static void Usage(char *app_name)
+{
+  fprintf(stderr, " %s [--filter <name>] [--reps <n>] [--min-time <ms>] [--cpu <cpu>]\n", app_name);
+}
+
+int main(int argc, char *argv[])
+{
+  struct BenchOption option = { BENCH_REPS_DEFAULT, BENCH_MIN_TIME_MS_DEFAULT, -1, NULL };
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      option.filter = argv[++i];
+    }
+    else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+      option.reps = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+      option.min_time_ms = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+      option.cpu = atoi(argv[++i]);
+    }
+    else {
+      Usage(argv[0]);
+      return -1;
+    }
+  }
+  if (option.reps <= 0) {
+    option.reps = BENCH_REPS_DEFAULT;
+  }
+
+  /* 결과는 원래 stdout 으로, PrintLog 출력은 /dev/null 로 */
+  g_json = fdopen(dup(STDOUT_FILENO), "w");
+  if (g_json == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+    fprintf(stderr, "Fail to redirect stdout\n");
+    return -1;
+  }
+
+  if (option.cpu >= 0) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(option.cpu, &cpu_set);
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+      fprintf(stderr, "Fail to pin cpu %d\n", option.cpu);
+    }
+  }
+
+  g_mib.log_level = kMessageType_None;
+  g_mib.device = -1;
+  g_mib.signal_event_fd = -1;
+  g_mib.shared_event_fd = -1;
+  g_mib.reload_event_fd = -1;
+  InitProfile(&g_mib.profile);
+  if (InitSink() < 0) {
+    fprintf(stderr, "Fail to initialize sink socket\n");
+    return -1;
+  }
+  InitFeedbackPacket();
+  InitBumperFrame();
+  bool shared_enabled = (option.filter == NULL || strstr("shm_round_trip", option.filter) != NULL);
+  if (shared_enabled && StartSharedServer() < 0) {
+    fprintf(stderr, "Fail to start shared memory server\n");
+    StopSharedServer();
+    return -1;
+  }
+
+  struct BenchCase benches[] = {
+    { "encode_speed", RunEncodeSpeed, NULL },
+    { "control_speed", RunControlSpeed, NULL },
+    { "control_led", RunControlLED, NULL },
+    { "parse_script", RunParseScript, NULL },
+    { "parse_feedback", RunParseFeedback, NULL },
+    { "reflex_bumper", RunReflex, NULL },
+    { "shm_round_trip", RunSharedRoundTrip, NULL },
+    { "trace_span_off", RunTraceSpanOff, NULL },
+    { "print_log_error", RunPrintLog, (void *)(intptr_t)kMessageType_Error },
+    { "print_log_pass", RunPrintLog, (void *)(intptr_t)kMessageType_Pass },
+    { "print_log_info", RunPrintLog, (void *)(intptr_t)kMessageType_Info },
+    { "print_log_debug", RunPrintLog, (void *)(intptr_t)kMessageType_Debug },
+    { "print_log_filtered", RunPrintLog, (void *)(intptr_t)kMessageType_Debug },
+  };
+
+  fprintf(g_json, "{\n  \"version\": \"%s\",\n  \"benchmarks\": [", _VERSION_);
+  bool first = true;
+  for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+    if (option.filter != NULL && strstr(benches[i].name, option.filter) == NULL) {
+      continue;
+    }
+    /* print_log_* 는 모든 레벨을 출력하고, filtered 는 레벨 검사에서 걸러지는 비용을 잰다. */
+    g_mib.log_level = kMessageType_None;
+    if (strncmp(benches[i].name, "print_log_", 10) == 0 && strcmp(benches[i].name, "print_log_filtered") != 0) {
+      g_mib.log_level = kMessageType_Debug;
+    }
+    RunBench(&benches[i], &option, first);
+    first = false;
+  }
+  fprintf(g_json, "\n  ]\n}\n");
+  fclose(g_json);
+  StopSharedServer();
+  return 0;
+}
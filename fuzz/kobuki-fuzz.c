@@ -0,0 +1,111 @@
+// C library headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// User headers
+#include "kobuki.h"
+
+/**
+ * @brief Fuzz target, selected by the first input byte
+ */
+enum eFuzzTarget
+{
+  kFuzzTarget_Script = 0,
+  kFuzzTarget_Feedback = 1,
+  kFuzzTarget_Frame = 2,
+  kFuzzTarget_Max = 3,
+};
+
+/**
+ * @brief 입력 하나를 parser/decoder 에 넣는다.
+ * @param[in] data 입력 (첫 byte: 대상 선택)
+ * @param[in] size 입력 길이
+ * @retval 0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  if (size < 1) {
+    return 0;
+  }
+  static bool initialized = false;
+  if (initialized == false) {
+    /* reflex 의 stop 전송은 socket 없이 실패하도록 둔다. */
+    g_mib.socket = -1;
+    KOBUKI_EncodeSpeed(g_mib.stop_frame, 0, 0);
+    InitReflex(&g_mib.reflex, REFLEX_DEFAULT_MASK, 0);
+    InitProfile(&g_mib.profile);
+    initialized = true;
+  }
+  g_mib.log_level = kMessageType_None;
+
+  int target = data[0] % kFuzzTarget_Max;
+  data++;
+  size--;
+
+  switch (target) {
+    case kFuzzTarget_Script: {
+      /* fmemopen 은 길이 0 을 허용하지 않는다. */
+      char *script = malloc(size + 1);
+      memcpy(script, data, size);
+      script[size] = '\0';
+      FILE *fp = fmemopen(script, size + 1, "r");
+      if (fp != NULL) {
+        ParseScriptStream(fp, &g_mib.profile, &g_mib.scripts[0]);
+        fclose(fp);
+      }
+      free(script);
+      break;
+    }
+    case kFuzzTarget_Feedback: {
+      struct FeedbackStatus feedback;
+      memset(&feedback, 0x00, sizeof(feedback));
+      ParseFeedbackPacket(data, size, &feedback);
+      break;
+    }
+    case kFuzzTarget_Frame: {
+      /* bridge 에서 받은 UDP frame: 정렬되지 않은 입력을 그대로 넘긴다. */
+      uint8_t buf[UDP_PACKET_MAX_SIZE];
+      if (size > sizeof(buf)) {
+        size = sizeof(buf);
+      }
+      memcpy(buf, data, size);
+      if (size >= sizeof(struct ReliableHeader)) {
+        /* session 검사를 통과시켜 payload 까지 decode 되도록 한다. */
+        g_mib.reliable.session = ((const struct ReliableHeader *)buf)->session;
+      }
+      HandleReliableAck(buf, size, GetTimeUs());
+      HandleSyncResponse(buf, size, GetTimeUs());
+      HandleFeedback(buf, size, GetTimeUs());
+      break;
+    }
+  }
+  return 0;
+}
+
+#ifdef KOBUKI_FUZZ_STANDALONE
+/**
+ * @brief libFuzzer 없이 파일(또는 stdin) 입력으로 실행한다. AFL, crash 재현용.
+ */
+int main(int argc, char *argv[])
+{
+  static uint8_t buf[1 << 16];
+
+  if (argc < 2) {
+    size_t len = fread(buf, 1, sizeof(buf), stdin);
+    return LLVMFuzzerTestOneInput(buf, len);
+  }
+  for (int i = 1; i < argc; i++) {
+    FILE *fp = fopen(argv[i], "rb");
+    if (fp == NULL) {
+      fprintf(stderr, "Fail to open %s\n", argv[i]);
+      continue;
+    }
+    size_t len = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    LLVMFuzzerTestOneInput(buf, len);
+  }
+  return 0;
+}
+#endif
@@ -0,0 +1,236 @@
+#include <math.h>
+#include <stddef.h>
+
+#include "kobuki.h"
+
+/**
+ * @brief --profile, --calibrate 파일의 항목
+ */
+static const struct ConfigKey g_profile_keys[] = {
+  { "wheel_base_mm", offsetof(struct KinematicProfile, wheel_base_mm), true },
+  { "tick_mm", offsetof(struct KinematicProfile, tick_mm), true },
+  { "speed_gain", offsetof(struct KinematicProfile, speed_gain), true },
+  { "time_offset_ms", offsetof(struct KinematicProfile, time_offset_ms), false },
+  { "spin_radius_mm", offsetof(struct KinematicProfile, spin_radius_mm), true },
+  { "arc_gain", offsetof(struct KinematicProfile, arc_gain), true },
+  { "latency_ms", offsetof(struct KinematicProfile, latency_ms), false },
+};
+
+/**
+ * @brief calibration 동작 하나의 측정값
+ */
+struct CalibrationResult
+{
+  int speed; ///< 명령 속도 mm/s 단위
+  int radius; ///< 명령 반경 mm 단위
+  int time_ms; ///< 명령 유지 시간
+  double left_mm; ///< 정지할 때까지 왼쪽 바퀴 이동 거리
+  double right_mm;
+  double angle_rad; ///< gyro 회전 각도, 반시계 방향이 양수
+  int latency_ms; ///< 명령 전송부터 encoder 가 처음 바뀐 feedback 까지, -1: 움직이지 않음
+};
+
+/**
+ * @brief Initialize the kinematic profile with the defaults (the former hard-coded constants)
+ * @param[out] profile kinematic profile
+ */
+void InitProfile(struct KinematicProfile *profile)
+{
+  profile->wheel_base_mm = PROFILE_WHEEL_BASE_DEFAULT_MM;
+  profile->tick_mm = PROFILE_TICK_DEFAULT_MM;
+  profile->speed_gain = 1.0f;
+  profile->time_offset_ms = 0;
+  profile->spin_radius_mm = PROFILE_SPIN_RADIUS_DEFAULT_MM;
+  profile->arc_gain = PROFILE_ARC_GAIN_DEFAULT;
+  profile->latency_ms = 0;
+}
+
+/**
+ * @brief kinematic profile 파일을 읽는다.
+ * @param[in] profile_file profile 파일 이름
+ * @param[in,out] profile 파일에 있는 항목만 바뀐다.
+ * @retval 0: 성공
+ * @retval -1: 실패
+ */
+int LoadProfile(const char *profile_file, struct KinematicProfile *profile)
+{
+  if (LoadConfigFile(profile_file, g_profile_keys, sizeof(g_profile_keys) / sizeof(g_profile_keys[0]), profile) < 0) {
+    PrintLog(kMessageType_Error, "Fail to load kinematic profile - %s\n", profile_file);
+    return -1;
+  }
+  if (profile->speed_gain <= 0 || profile->spin_radius_mm <= 0 || profile->arc_gain <= 0 ||
+      profile->wheel_base_mm < 0 || profile->latency_ms < 0) {
+    PrintLog(kMessageType_Error, "Fail to load kinematic profile - %s, value out of range\n", profile_file);
+    return -1;
+  }
+  PrintLog(kMessageType_Pass, "Success to load kinematic profile - %s\n", profile_file);
+  PrintLog(kMessageType_Debug, "wheel_base: %.1fmm, speed_gain: %.3f, time_offset: %dms, spin_radius: %.1fmm, arc_gain: %.3f, latency: %dms\n",
+          profile->wheel_base_mm, profile->speed_gain, profile->time_offset_ms, profile->spin_radius_mm,
+          profile->arc_gain, profile->latency_ms);
+  return 0;
+}
+
+/**
+ * @brief kinematic profile 파일을 쓴다. LoadProfile() 로 다시 읽을 수 있다.
+ * @param[in] profile_file profile 파일 이름
+ * @param[in] profile kinematic profile
+ * @retval 0: 성공
+ * @retval -1: 실패
+ */
+int SaveProfile(const char *profile_file, const struct KinematicProfile *profile)
+{
+  FILE *fp = fopen(profile_file, "w");
+  if (fp == NULL) {
+    PrintLog(kMessageType_Error, "Fail to open kinematic profile - %s\n", profile_file);
+    return -1;
+  }
+
+  fprintf(fp, "# kobuki kinematic profile, written by --calibrate\n");
+  fprintf(fp, "wheel_base_mm %.1f\n", profile->wheel_base_mm);
+  fprintf(fp, "tick_mm %.6f\n", profile->tick_mm);
+  fprintf(fp, "speed_gain %.4f\n", profile->speed_gain);
+  fprintf(fp, "time_offset_ms %d\n", profile->time_offset_ms);
+  fprintf(fp, "spin_radius_mm %.1f\n", profile->spin_radius_mm);
+  fprintf(fp, "arc_gain %.4f\n", profile->arc_gain);
+  fprintf(fp, "latency_ms %d\n", profile->latency_ms);
+  fclose(fp);
+
+  PrintLog(kMessageType_Pass, "Success to write kinematic profile - %s\n", profile_file);
+  return 0;
+}
+
+/**
+ * @brief 정지 상태에서 명령 하나를 time_ms 동안 실행하고, 정지할 때까지의 이동을 측정한다.
+ * @param[in,out] result speed, radius, time_ms 를 받고 측정값을 채운다.
+ * @retval 0: 성공
+ * @retval -1: 실패 (feedback 없음, reflex, 종료 시그널)
+ */
+static int MeasureCalibration(struct CalibrationResult *result)
+{
+  const EventType wake_mask = kEventType_Feedback | kEventType_Reflex | kEventType_Terminate;
+
+  /* 정지 상태에서 시작 */
+  SetCommandTime(0);
+  KOBUKI_ControlSpeed(g_mib.device, 0, 0);
+  int ret = WaitEventUntil(GetTimeUs() + CALIB_SETTLE_MS * 1000, kEventType_Reflex | kEventType_Terminate);
+  if (ret != 0) {
+    return -1;
+  }
+  FeedbackType required = kFeedbackType_BasicSensor | kFeedbackType_InertialSensor;
+  if ((g_mib.feedback.valid & required) != required) {
+    PrintLog(kMessageType_Error, "Fail to calibrate - no encoder or gyro feedback, valid: 0x%X\n", g_mib.feedback.valid);
+    return -1;
+  }
+
+  /* 이동량은 odometry 누적값의 차이로 구한다. */
+  struct OdometryStatus start = g_mib.odometry;
+  uint32_t packet_count = g_mib.feedback.packet_count;
+  result->latency_ms = -1;
+
+  g_mib.command_id++;
+  uint64_t start_us = GetTimeUs();
+  uint64_t stop_us = start_us + (uint64_t)result->time_ms * 1000;
+  uint64_t settle_us = stop_us + CALIB_SETTLE_MS * 1000;
+  bool stopped = false;
+  KOBUKI_ControlSpeed(g_mib.device, result->speed, result->radius);
+  while (true) {
+    uint64_t now_us = GetTimeUs();
+    if (stopped == false && now_us >= stop_us) {
+      KOBUKI_ControlSpeed(g_mib.device, 0, 0);
+      stopped = true;
+    }
+    if (now_us >= settle_us) {
+      break;
+    }
+    ret = WaitEventUntil(stopped ? settle_us : stop_us, wake_mask);
+    if (ret < 0 || (ret & (kEventType_Reflex | kEventType_Terminate))) {
+      KOBUKI_EmergencyStop();
+      PrintLog(kMessageType_Error, "Fail to calibrate - interrupted, events: 0x%X\n", ret);
+      return -1;
+    }
+    if ((ret & kEventType_Feedback) && result->latency_ms < 0 &&
+        (g_mib.odometry.left_mm != start.left_mm || g_mib.odometry.right_mm != start.right_mm)) {
+      result->latency_ms = (int)((g_mib.odometry.update_us - start_us) / 1000);
+    }
+  }
+  result->left_mm = g_mib.odometry.left_mm - start.left_mm;
+  result->right_mm = g_mib.odometry.right_mm - start.right_mm;
+  result->angle_rad = g_mib.odometry.theta_rad - start.theta_rad;
+
+  if (g_mib.feedback.packet_count == packet_count || result->latency_ms < 0) {
+    PrintLog(kMessageType_Error, "Fail to calibrate - no movement, speed: %d, radius: %d, feedback: %u\n",
+            result->speed, result->radius, g_mib.feedback.packet_count - packet_count);
+    return -1;
+  }
+  PrintLog(kMessageType_Info, "Calibration run - speed: %d, radius: %d, time: %dms, left: %.1fmm, right: %.1fmm, angle: %.2fdeg, latency: %dms\n",
+          result->speed, result->radius, result->time_ms, result->left_mm, result->right_mm,
+          result->angle_rad * 180 / M_PI, result->latency_ms);
+  return 0;
+}
+
+/**
+ * @brief 정해진 동작(직선 2회, 제자리 회전, 곡선)으로 encoder, gyro 를 측정해서 profile 을 맞추고 파일에 쓴다.
+ * @param[in] profile_file 결과를 쓸 profile 파일 이름
+ * @retval 0: 성공
+ * @retval -1: 실패
+ * @details 직선: 거리 = speed_gain * 속도 * (시간 - time_offset), 두 시간으로 두 값을 구한다.
+ *          제자리 회전: wheel_base = 바퀴 거리 차이 / 각도, spin_radius = 속도 * 시간 / 각도
+ *          곡선: arc_gain = 속도 * 시간 / (반경 * 각도)
+ *          지연은 시작, 정지에 똑같이 더해져 이동량에 나타나지 않으므로 encoder 가 처음 바뀐 시각으로 구한다.
+ *          앞으로 약 1m, 제자리 회전, 반경 0.4m 곡선으로 움직이므로 넓은 곳에서 실행한다.
+ */
+int RunCalibration(const char *profile_file)
+{
+  struct CalibrationResult runs[] = {
+    { .speed = CALIB_SPEED, .radius = 0, .time_ms = CALIB_SHORT_MS },
+    { .speed = CALIB_SPEED, .radius = 0, .time_ms = CALIB_LONG_MS },
+    { .speed = CALIB_SPIN_SPEED, .radius = 1, .time_ms = CALIB_TURN_MS },
+    { .speed = CALIB_SPEED, .radius = CALIB_ARC_RADIUS, .time_ms = CALIB_TURN_MS },
+  };
+  const int runs_size = sizeof(runs) / sizeof(runs[0]);
+
+  PrintLog(kMessageType_Pass, "Start to calibrate kinematic profile\n");
+  for (int i = 0; i < runs_size; i++) {
+    if (MeasureCalibration(&runs[i]) < 0) {
+      return -1;
+    }
+  }
+
+  struct KinematicProfile profile = g_mib.profile;
+  struct CalibrationResult *short_run = &runs[0];
+  struct CalibrationResult *long_run = &runs[1];
+  struct CalibrationResult *spin_run = &runs[2];
+  struct CalibrationResult *arc_run = &runs[3];
+
+  double short_mm = (short_run->left_mm + short_run->right_mm) / 2;
+  double long_mm = (long_run->left_mm + long_run->right_mm) / 2;
+  double speed_gain = (long_mm - short_mm) / (CALIB_SPEED * (long_run->time_ms - short_run->time_ms) / 1000.0);
+  double spin_angle = fabs(spin_run->angle_rad);
+  double arc_angle = fabs(arc_run->angle_rad);
+  if (speed_gain <= 0 || spin_angle < 0.1 || arc_angle < 0.1) {
+    PrintLog(kMessageType_Error, "Fail to calibrate - speed_gain: %.3f, spin: %.3frad, arc: %.3frad\n", speed_gain, spin_angle, arc_angle);
+    return -1;
+  }
+
+  profile.speed_gain = speed_gain;
+  profile.time_offset_ms = (int)lround(short_run->time_ms - short_mm / (speed_gain * CALIB_SPEED) * 1000);
+  profile.wheel_base_mm = fabs(spin_run->right_mm - spin_run->left_mm) / spin_angle;
+  profile.spin_radius_mm = spin_run->speed * (spin_run->time_ms / 1000.0) / spin_angle;
+  profile.arc_gain = arc_run->speed * (arc_run->time_ms / 1000.0) / (arc_run->radius * arc_angle);
+
+  int latency_sum_ms = 0;
+  for (int i = 0; i < runs_size; i++) {
+    latency_sum_ms += runs[i].latency_ms;
+  }
+  /* 명령 전송, feedback 수신에 걸린 시간(RTT)은 빼고, 실행 시각 지정 명령은 bridge 시각으로 실행된다. */
+  profile.latency_ms = latency_sum_ms / runs_size - g_mib.reliable.srtt_us / 1000;
+  if (profile.latency_ms < 0) {
+    profile.latency_ms = 0;
+  }
+
+  PrintLog(kMessageType_Pass, "Success to calibrate - wheel_base: %.1fmm, speed_gain: %.3f, time_offset: %dms, spin_radius: %.1fmm, arc_gain: %.3f, latency: %dms\n",
+          profile.wheel_base_mm, profile.speed_gain, profile.time_offset_ms, profile.spin_radius_mm,
+          profile.arc_gain, profile.latency_ms);
+  g_mib.profile = profile;
+  return SaveProfile(profile_file, &profile);
+}
@@ -1,293 +1,877 @@
-// C library headers
-#include <stdio.h>
-#include <stdint.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdarg.h>
-#include <signal.h>
-#include <unistd.h>
-#include <stdbool.h>
-#include <netinet/in.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
-#include <netinet/in.h>
-
-// Linux headers
-#include <fcntl.h> // Contains file controls like O_RDWR
-#include <termios.h> // Contains POSIX terminal control definitions
-#include <unistd.h> // write(), read(), close()
-
-// User headers
-#include "kobuki.h"
-
-struct MIB g_mib;
-
-/**
- * @brief 어플리케이션 종료 시에 호출되는 시그널 함수
- * @param[in] signum 시그널 번호
- * @details 종료 시에 반드시 close() 함수가 호출되어야 한다.
- * */
-static void TerminateEvent(int signum)
-{
-  (void)signum;
-
-  PrintLog(kMessageType_Info, "Application terminating\n");
-	KOBUKI_ControlSpeed(g_mib.device, 0, 0);
-  if (g_mib.device < 0) {
-    close(g_mib.device);
-  }
-  PrintLog(kMessageType_Pass, "Success to terminate\n");
-  exit(0);
-}
-
-
-/**
- * @brief input parameter 파싱
- * @param[in] argc 파라미터 개수
- * @param[in] argv 파라미터
- * @retval 0: 성공
- * @retval -1: 실패
- * */
-int ParseInputParameter(int argc, char *argv[])
-{
-  g_mib.log_level = kMessageType_Error;
-  strcpy(g_mib.script_file_name, "script.txt");
-  strcpy(g_mib.server_ip_addr, "192.168.240.1");
-  g_mib.server_port_num = 5555;
-  strcpy(g_mib.baud_rate, "115200");
-  memset(g_mib.device_name, 0x00, sizeof(g_mib.device_name));
-
-  for (int i = 0; i < argc; i++) {
-    if (strcmp(argv[i], "--help") == 0) {
-      return -1;
-    }
-    if (strcmp(argv[i], "--ip") == 0) {
-      if (i + 1 < argc) {
-        strcpy(g_mib.server_ip_addr, argv[i + 1]);
-      }
-      else {
-        PrintLog(kMessageType_Error, "Fail to parse input parameters - server_ip_addr\n");
-        return -1;
-      }
-    }
-    if (strcmp(argv[i], "--port") == 0) {
-      if (i + 1 < argc) {
-        g_mib.server_port_num = atoi(argv[i + 1]);
-      }
-      else {
-        PrintLog(kMessageType_Error, "Fail to parse input parameters - server_port_num\n");
-        return -1;
-      }
-    }
-#if 0
-    if (strcmp(argv[i], "--dev") == 0) {
-      if (i + 1 < argc) {
-        strcpy(g_mib.device_name, argv[i + 1]);
-      }
-      else {
-        PrintLog(kMessageType_Error, "Fail to parse input parameters - device_name\n");
-        return -1;
-      }
-    }
-#endif
-    if (strcmp(argv[i], "--baud") == 0) {
-      if (i + 1 < argc) {
-        strcpy(g_mib.baud_rate, argv[i + 1]);
-      }
-      else {
-        PrintLog(kMessageType_Error, "Fail to parse input parameters - baud_rate\n");
-        return - 1;
-      }
-    }
-
-    if (strcmp(argv[i], "--script") == 0) {
-      if (i + 1 < argc) {
-        strcpy(g_mib.script_file_name, argv[i + 1]);
-      }
-      else {
-        PrintLog(kMessageType_Error, "Fail to parse input parameters - script_file_name\n");
-        return -1;
-      }
-    }
-
-    if (strcmp(argv[i], "--dbg") == 0) {
-      if (i + 1 < argc) {
-        g_mib.log_level = atoi(argv[i + 1]);
-      }
-      else {
-        PrintLog(kMessageType_Error, "Fail to parse input parameters - log_level\n");
-        return -1;
-      }
-    }
-  }
-
-  // if (g_mib.baud_rate[0] == '\0') {
-  //   PrintLog(kMessageType_Error, "Fail to parse input parameters - baud_rate\n");
-  //   return - 1;
-  // }
-  // if (g_mib.device_name[0] == '\0') {
-  //   PrintLog(kMessageType_Error, "Fail to parse input parameters - device_name\n");
-  //   return -1;
-  // }
-  PrintLog(kMessageType_Pass, "Success to parse input parameters\n");
-  PrintLog(kMessageType_Debug, "server_ip_addr: %s\n", g_mib.server_ip_addr);
-  PrintLog(kMessageType_Debug, "server_port_num: %d\n", g_mib.server_port_num);
-  PrintLog(kMessageType_Debug, "device_name: %s\n", g_mib.device_name);
-  PrintLog(kMessageType_Debug, "baud_rate: %s\n", g_mib.baud_rate);
-  PrintLog(kMessageType_Debug, "script_file_name: %s\n", g_mib.script_file_name);
-  PrintLog(kMessageType_Debug, "log_level: %d\n", g_mib.log_level);
-  return 0;
-}
-
-
-/**
- * @brief print usage
- * */
-void Usage(char *app_name)
-{
-  printf("\n\n");
-  printf(" Description: Communicate with kobuki device using serial communication\n");
-  printf(" Version: %s\n", _VERSION_);
-  printf(" Author: wuppu\n");
-  printf(" Email: wndud1640@gmail.com\n");
-
-  printf("\n");
-  printf(" [USAGE]\n");
-  printf(" %s <OPTIONS>\n", app_name);
-  printf(" --ip <ip_address>         Arduino IPv4 address. If not specified, set to 192.168.240.1\n");
-  printf(" --port <port_number>      Arduino UDP port number. If not specified, set to 5555\n");
-  // printf(" --dev <device_name>       Device name in \"/dev/\" directory\n");
-  printf(" --baud <baud_rate>        Serial port baud rate. if not specified, set to 115200\n");
-  printf("     1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 bits per seconds\n");
-  printf(" --script <script_file>    Script file name. If not specified, set to ./script.txt\n");
-  printf(" --dbg <dbg_level>         Print log level. If not specified, set to 1\n");
-  printf("     0: None, 1: Error, 2: Event, 3: Info, 4: Debug\n");
-  printf("\n\n");
-}
-
-
-int main(int argc, char* argv[])
-{
-  g_mib.log_level = kMessageType_Error;
-
-  /* application terminate handler 등록 */
-  struct sigaction sig_action;
-  memset(&sig_action, 0x00, sizeof(sig_action));
-  sig_action.sa_handler = TerminateEvent;
-  sigemptyset(&sig_action.sa_mask);
-  sig_action.sa_flags = 0;
-  if (sigaction(SIGINT, &sig_action, NULL) != 0) {
-    PrintLog(kMessageType_Error, "Fail to sigaction - SIGINT\n");
-  }
-  if (sigaction(SIGHUP, &sig_action, NULL) != 0) {
-    PrintLog(kMessageType_Error, "Fail to sigaction - SIGHUP\n");
-  }
-  if (sigaction(SIGTERM, &sig_action, NULL) != 0) {
-    PrintLog(kMessageType_Error, "Fail to sigaction - SIGTERM\n");
-  }
-  if (sigaction(SIGSEGV, &sig_action, NULL) != 0) {
-    PrintLog(kMessageType_Error, "Fail to sigaction - SIGSEGV\n");
-  }
-
-  /* help 출력 */
-  // if (argc == 1) {
-  //   Usage(argv[0]);
-  //   TerminateEvent(-1);
-  // }
-
-  /* input parameters 처리 */
-  int ret = ParseInputParameter(argc, argv);
-  if (ret < 0) {
-    Usage(argv[0]);
-    TerminateEvent(-1);
-  }
-  /* script file 처리 */
-
-  ret = ParseScriptCommand(g_mib.script_file_name, &g_mib);
-  if (ret < 0) {
-    TerminateEvent(-1);
-  }
-
-  ret = InitUDP(g_mib.server_ip_addr, g_mib.server_port_num, &g_mib.server_addr, &g_mib.socket);
-  if (ret < 0) {
-    TerminateEvent(-1);
-  }
-
-  /* 초기 동작 LED 점등 (3초) */
-	KOBUKI_ControlSpeed(g_mib.device, 0, 0);
-  KOBUKI_ControlLED(g_mib.device, 1, kLEDColor_None);
-  KOBUKI_ControlLED(g_mib.device, 2, kLEDColor_None);
-  sleep(1);  
-  KOBUKI_ControlLED(g_mib.device, 1, kLEDColor_Red);
-  sleep(1);  
-  KOBUKI_ControlLED(g_mib.device, 2, kLEDColor_Red);
-  sleep(1);  
-  KOBUKI_ControlLED(g_mib.device, 1, kLEDColor_Green);
-  KOBUKI_ControlLED(g_mib.device, 2, kLEDColor_Green);
-  sleep(1);
-
-  /* script 내용 순차 처리 */
-  for (int i = 0; i < g_mib.script_lines_size; i++) {
-    switch (g_mib.script_lines[i].type) {
-      case kCommandType_None:
-        continue;
-      case kCommandType_LED:
-        KOBUKI_ControlLED(g_mib.device, g_mib.script_lines[i].led_num, g_mib.script_lines[i].color);
-        break;
-      case kCommandType_Sleep:
-        usleep(g_mib.script_lines[i].delay * 1000);
-        break;
-      case kCommandType_Speed:
-        KOBUKI_ControlSpeed(g_mib.device, g_mib.script_lines[i].speed, g_mib.script_lines[i].radius);
-
-				usleep(g_mib.script_lines[i].move_time * 1000);
-
-				KOBUKI_ControlSpeed(g_mib.device, 0, 0);
-        break;
-    }
-  }
-
-  /* script 내용 처리 - LED off */
-  KOBUKI_ControlLED(g_mib.device, 1, kLEDColor_None);
-  KOBUKI_ControlLED(g_mib.device, 2, kLEDColor_None);  
-  KOBUKI_ControlSpeed(g_mib.device, 0, 0);
-
-#if 0
-  unsigned char buf[1000];
-  memset(buf, 0x00, sizeof(buf));
-
-
-  while (true) {
-    int recv_len = read(g_mib.device, buf, sizeof(buf));
-    if (recv_len < 0) {
-      continue;
-      PrintLog(kMessageType_Error, "Fail to read %s serial port\n", g_mib.device_name);
-      // TerminateEvent(-1);
-    }
-
-    PrintLog(kMessageType_Debug, "recv_len: %d\n", recv_len);
-    PrintLog(kMessageType_Debug, "recv: \n");
-    for (int i = 0; i < recv_len; i++) {
-
-      if (i != 0 && i % 8 == 0) {
-        if (i != 0 && i % 16 == 0) {
-          printf("\n");
-        }
-        else {
-          printf(" ");
-        }
-      }
-      if (i % 16 == 0) {
-        printf("%06X ", i);
-      }
-      printf("%02X ", buf[i]);
-    }
-    printf("\n");
-  }
-
-  PrintLog(kMessageType_Pass, "Done\n");
-  close(g_mib.device); //close serial port
-#endif
-  return 0;
-}
+// C library headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+// Linux headers
+#include <fcntl.h> // Contains file controls like O_RDWR
+#include <termios.h> // Contains POSIX terminal control definitions
+#include <unistd.h> // write(), read(), close()
+
+// User headers
+#include "kobuki.h"
+
+/**
+ * @brief stop 이 ack 된 뒤 basic sensor 의 encoder 가 멈췄는지 확인한다.
+ * @param[in] deadline_us 확인을 포기하는 시각
+ * @retval 1: encoder 가 STOP_STILL_FRAMES 번 연속 바뀌지 않음
+ * @retval 0: 시간 초과 (아직 움직임)
+ * @retval -1: basic sensor feedback 을 받은 적이 없음
+ * */
+static int ConfirmStillEncoder(uint64_t deadline_us)
+{
+  struct BasicSensorFormat *basic_sensor = &g_mib.feedback.basic_sensor;
+
+  if ((g_mib.feedback.valid & kFeedbackType_BasicSensor) == 0) {
+    return -1;
+  }
+  uint16_t timestamp = basic_sensor->timestamp;
+  uint16_t left_encoder = basic_sensor->left_encoder;
+  uint16_t right_encoder = basic_sensor->right_encoder;
+  int still_count = 0;
+  g_mib.events &= ~kEventType_Feedback;
+  while (GetTimeUs() < deadline_us) {
+    if (WaitEventUntil(deadline_us, kEventType_Feedback) <= 0) {
+      break;
+    }
+    /* inertial sensor 만 있는 frame 은 건너뛴다. */
+    if (basic_sensor->timestamp == timestamp) {
+      continue;
+    }
+    still_count = (basic_sensor->left_encoder == left_encoder && basic_sensor->right_encoder == right_encoder) ? still_count + 1 : 0;
+    timestamp = basic_sensor->timestamp;
+    left_encoder = basic_sensor->left_encoder;
+    right_encoder = basic_sensor->right_encoder;
+    if (still_count >= STOP_STILL_FRAMES) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief 어플리케이션 종료 처리
+ * @param[in] signum 시그널 번호, -1: 오류로 인한 종료 (exit status 1)
+ * @details 종료 시에 반드시 close() 함수가 호출되어야 한다.
+ *          stop 명령이 bridge 에 전달(ack)될 때까지 STOP_RETRY_MAX 번 재전송한다.
+ *          ack 뒤에는 basic sensor feedback 이 있으면 encoder 가 멈출 때까지 STOP_STILL_TIMEOUT_MS 동안 기다린다.
+ * */
+static void TerminateEvent(int signum)
+{
+  PrintLog(kMessageType_Info, "Application terminating - signal: %d\n", signum);
+
+  if (g_mib.socket >= 0) {
+    /* 시그널 종료는 시그널 전달부터 ack 까지를 잰다. */
+    uint64_t confirm_start_us = (g_mib.terminate_signal != 0) ? g_mib.terminate_signal_us : GetMonotonicTimeUs();
+    if (g_mib.terminate_signal == 0) {
+      KOBUKI_EmergencyStop();
+    }
+    for (int retry = 0; retry <= STOP_RETRY_MAX; retry++) {
+      uint64_t retry_deadline_us = GetTimeUs() + STOP_RETRY_INTERVAL_MS * 1000;
+      while (IsReliableStateAcked(BASE_CONTROL_ID) == false && GetTimeUs() < retry_deadline_us) {
+        WaitEventUntil(retry_deadline_us, kEventType_Ack);
+      }
+      if (IsReliableStateAcked(BASE_CONTROL_ID) || retry == STOP_RETRY_MAX) {
+        break;
+      }
+      KOBUKI_EmergencyStop();
+    }
+
+    if (IsReliableStateAcked(BASE_CONTROL_ID)) {
+      PrintLog(kMessageType_Pass, "Success to confirm stop - signal to stop: %dus, confirm: %dus\n",
+              g_mib.stop_latency_us, (int)(GetMonotonicTimeUs() - confirm_start_us));
+      uint64_t still_start_us = GetTimeUs();
+      int still = ConfirmStillEncoder(still_start_us + STOP_STILL_TIMEOUT_MS * 1000);
+      if (still > 0) {
+        PrintLog(kMessageType_Pass, "Success to check encoders stopped - still after: %dms\n", (int)((GetTimeUs() - still_start_us) / 1000));
+      }
+      else if (still == 0) {
+        PrintLog(kMessageType_Error, "Fail to check encoders stopped - still moving after %dms\n", STOP_STILL_TIMEOUT_MS);
+      }
+      else {
+        PrintLog(kMessageType_Info, "Skip encoder stop check - no basic sensor feedback\n");
+      }
+    }
+    else {
+      PrintLog(kMessageType_Error, "Fail to confirm stop - signal to stop: %dus\n", g_mib.stop_latency_us);
+    }
+    close(g_mib.socket);
+  }
+  if (g_mib.shared != NULL) {
+    /* helper thread 가 futex 대기 중에 공유 메모리가 unmap 되지 않도록 먼저 종료한다. */
+    StopSharedNotify();
+    CloseSharedRegion(g_mib.shared, g_mib.shared_name, true);
+  }
+  if (g_mib.sim.initialized) {
+    CloseSim();
+  }
+  WriteTrace(g_mib.trace_file_name);
+
+  if (g_mib.device >= 0) {
+    close(g_mib.device);
+  }
+  PrintLog(kMessageType_Pass, "Success to terminate\n");
+  exit((signum < 0) ? EXIT_FAILURE : 0);
+}
+
+/**
+ * @brief 비정상 종료(SIGSEGV) 시그널 함수
+ * @param[in] signum 시그널 번호
+ * @details async-signal-safe 함수만 사용한다. 미리 만들어 둔 stop 패킷을 그대로 전송한다.
+ * */
+static void CrashEvent(int signum)
+{
+  if (g_mib.socket >= 0) {
+    sendto(g_mib.socket, g_mib.stop_frame, SPEED_FRAME_LEN, 0, (struct sockaddr *)&g_mib.server_addr, sizeof(g_mib.server_addr));
+  }
+  signal(signum, SIG_DFL);
+  raise(signum);
+}
+
+/**
+ * @brief 주어진 시각까지 대기하고, 종료 시그널을 받으면 종료한다.
+ * @param[in] deadline_us 대기 종료 시각
+ * @param[in] wake_mask 대기를 중단시킬 이벤트
+ * @return 대기를 중단시킨 이벤트, 시간이 다 지나면 0
+ * */
+static int WaitOrTerminate(uint64_t deadline_us, EventType wake_mask)
+{
+  TRACE_BEGIN(trace_span);
+  int ret = WaitEventUntil(deadline_us, wake_mask | kEventType_Terminate);
+  TRACE_END(trace_span, "wait");
+  if (ret > 0 && (ret & kEventType_Terminate)) {
+    TerminateEvent(g_mib.terminate_signal);
+  }
+  return ret;
+}
+
+
+/**
+ * @brief input parameter 파싱
+ * @param[in] argc 파라미터 개수
+ * @param[in] argv 파라미터
+ * @retval 0: 성공
+ * @retval -1: 실패
+ * */
+int ParseInputParameter(int argc, char *argv[])
+{
+  g_mib.log_level = kMessageType_Error;
+  strcpy(g_mib.script_file_name, "script.txt");
+  strcpy(g_mib.server_ip_addr, "192.168.240.1");
+  g_mib.server_port_num = 5555;
+  g_mib.sync_lead_ms = SYNC_LEAD_DEFAULT_MS;
+  g_mib.ready_timeout_ms = READY_TIMEOUT_DEFAULT_MS;
+  g_mib.boot_led = false;
+  g_mib.reflex_mask = REFLEX_DEFAULT_MASK;
+  g_mib.reflex_backoff_speed = 0;
+  memset(g_mib.link_policy_file_name, 0x00, sizeof(g_mib.link_policy_file_name));
+  memset(g_mib.profile_file_name, 0x00, sizeof(g_mib.profile_file_name));
+  memset(g_mib.calibrate_file_name, 0x00, sizeof(g_mib.calibrate_file_name));
+  memset(g_mib.shared_name, 0x00, sizeof(g_mib.shared_name));
+  g_mib.reload_mode = kReloadMode_None;
+  g_mib.clock_type = kClockType_Monotonic;
+  memset(g_mib.timeline_file_name, 0x00, sizeof(g_mib.timeline_file_name));
+  memset(g_mib.sim_config_file_name, 0x00, sizeof(g_mib.sim_config_file_name));
+  memset(g_mib.trace_file_name, 0x00, sizeof(g_mib.trace_file_name));
+  strcpy(g_mib.baud_rate, "115200");
+  memset(g_mib.device_name, 0x00, sizeof(g_mib.device_name));
+
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "--help") == 0) {
+      return -1;
+    }
+    if (strcmp(argv[i], "--ip") == 0) {
+      if (i + 1 < argc) {
+        strcpy(g_mib.server_ip_addr, argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - server_ip_addr\n");
+        return -1;
+      }
+    }
+    if (strcmp(argv[i], "--port") == 0) {
+      if (i + 1 < argc) {
+        g_mib.server_port_num = atoi(argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - server_port_num\n");
+        return -1;
+      }
+    }
+#if 0
+    if (strcmp(argv[i], "--dev") == 0) {
+      if (i + 1 < argc) {
+        strcpy(g_mib.device_name, argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - device_name\n");
+        return -1;
+      }
+    }
+#endif
+    if (strcmp(argv[i], "--baud") == 0) {
+      if (i + 1 < argc) {
+        strcpy(g_mib.baud_rate, argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - baud_rate\n");
+        return - 1;
+      }
+    }
+
+    if (strcmp(argv[i], "--script") == 0) {
+      if (i + 1 < argc) {
+        strcpy(g_mib.script_file_name, argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - script_file_name\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--lead") == 0) {
+      if (i + 1 < argc) {
+        g_mib.sync_lead_ms = atoi(argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - sync_lead_ms\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--ready-timeout") == 0) {
+      if (i + 1 < argc) {
+        g_mib.ready_timeout_ms = atoi(argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - ready_timeout_ms\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--boot-led") == 0) {
+      g_mib.boot_led = true;
+    }
+
+    if (strcmp(argv[i], "--reflex") == 0) {
+      if (i + 1 < argc) {
+        g_mib.reflex_mask = strtoul(argv[i + 1], NULL, 0) & REFLEX_DEFAULT_MASK;
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - reflex_mask\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--reflex-backoff") == 0) {
+      if (i + 1 < argc) {
+        g_mib.reflex_backoff_speed = abs(atoi(argv[i + 1]));
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - reflex_backoff_speed\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--link-policy") == 0) {
+      if (i + 1 < argc && strlen(argv[i + 1]) < sizeof(g_mib.link_policy_file_name)) {
+        strcpy(g_mib.link_policy_file_name, argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - link_policy_file_name\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--profile") == 0) {
+      if (i + 1 < argc && strlen(argv[i + 1]) < sizeof(g_mib.profile_file_name)) {
+        strcpy(g_mib.profile_file_name, argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - profile_file_name\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--calibrate") == 0) {
+      if (i + 1 < argc && strlen(argv[i + 1]) < sizeof(g_mib.calibrate_file_name)) {
+        strcpy(g_mib.calibrate_file_name, argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - calibrate_file_name\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--shm") == 0) {
+      if (i + 1 < argc && strlen(argv[i + 1]) + 1 < sizeof(g_mib.shared_name)) {
+        /* shm_open() 이름은 '/' 로 시작한다. */
+        snprintf(g_mib.shared_name, sizeof(g_mib.shared_name), "%s%s", argv[i + 1][0] == '/' ? "" : "/", argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - shared_name\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--reload") == 0) {
+      if (i + 1 < argc && strcmp(argv[i + 1], "segment") == 0) {
+        g_mib.reload_mode = kReloadMode_Segment;
+      }
+      else if (i + 1 < argc && strcmp(argv[i + 1], "stop") == 0) {
+        g_mib.reload_mode = kReloadMode_Stop;
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - reload_mode\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--virtual") == 0) {
+      g_mib.clock_type = kClockType_Virtual;
+    }
+
+    if (strcmp(argv[i], "--timeline") == 0) {
+      if (i + 1 < argc && strlen(argv[i + 1]) < sizeof(g_mib.timeline_file_name)) {
+        strcpy(g_mib.timeline_file_name, argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - timeline_file_name\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--sim-config") == 0) {
+      if (i + 1 < argc && strlen(argv[i + 1]) < sizeof(g_mib.sim_config_file_name)) {
+        strcpy(g_mib.sim_config_file_name, argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - sim_config_file_name\n");
+        return -1;
+      }
+    }
+
+    if (strcmp(argv[i], "--trace") == 0) {
+#ifdef KOBUKI_ENABLE_TRACE
+      if (i + 1 < argc && strlen(argv[i + 1]) < sizeof(g_mib.trace_file_name)) {
+        strcpy(g_mib.trace_file_name, argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - trace_file_name\n");
+        return -1;
+      }
+#else
+      PrintLog(kMessageType_Error, "Fail to parse input parameters - built without KOBUKI_ENABLE_TRACE\n");
+      return -1;
+#endif
+    }
+
+    if (strcmp(argv[i], "--dbg") == 0) {
+      if (i + 1 < argc) {
+        g_mib.log_level = atoi(argv[i + 1]);
+      }
+      else {
+        PrintLog(kMessageType_Error, "Fail to parse input parameters - log_level\n");
+        return -1;
+      }
+    }
+  }
+
+  // if (g_mib.baud_rate[0] == '\0') {
+  //   PrintLog(kMessageType_Error, "Fail to parse input parameters - baud_rate\n");
+  //   return - 1;
+  // }
+  // if (g_mib.device_name[0] == '\0') {
+  //   PrintLog(kMessageType_Error, "Fail to parse input parameters - device_name\n");
+  //   return -1;
+  // }
+  PrintLog(kMessageType_Pass, "Success to parse input parameters\n");
+  PrintLog(kMessageType_Debug, "server_ip_addr: %s\n", g_mib.server_ip_addr);
+  PrintLog(kMessageType_Debug, "server_port_num: %d\n", g_mib.server_port_num);
+  PrintLog(kMessageType_Debug, "device_name: %s\n", g_mib.device_name);
+  PrintLog(kMessageType_Debug, "baud_rate: %s\n", g_mib.baud_rate);
+  PrintLog(kMessageType_Debug, "script_file_name: %s\n", g_mib.script_file_name);
+  PrintLog(kMessageType_Debug, "log_level: %d\n", g_mib.log_level);
+  PrintLog(kMessageType_Debug, "sync_lead_ms: %d\n", g_mib.sync_lead_ms);
+  PrintLog(kMessageType_Debug, "ready_timeout_ms: %d\n", g_mib.ready_timeout_ms);
+  PrintLog(kMessageType_Debug, "boot_led: %d\n", g_mib.boot_led);
+  PrintLog(kMessageType_Debug, "reflex_mask: 0x%X\n", g_mib.reflex_mask);
+  PrintLog(kMessageType_Debug, "reflex_backoff_speed: %d\n", g_mib.reflex_backoff_speed);
+  PrintLog(kMessageType_Debug, "link_policy_file_name: %s\n", g_mib.link_policy_file_name);
+  PrintLog(kMessageType_Debug, "profile_file_name: %s\n", g_mib.profile_file_name);
+  PrintLog(kMessageType_Debug, "calibrate_file_name: %s\n", g_mib.calibrate_file_name);
+  PrintLog(kMessageType_Debug, "shared_name: %s\n", g_mib.shared_name);
+  PrintLog(kMessageType_Debug, "reload_mode: %d\n", g_mib.reload_mode);
+  PrintLog(kMessageType_Debug, "clock_type: %d\n", g_mib.clock_type);
+  PrintLog(kMessageType_Debug, "timeline_file_name: %s\n", g_mib.timeline_file_name);
+  PrintLog(kMessageType_Debug, "sim_config_file_name: %s\n", g_mib.sim_config_file_name);
+  PrintLog(kMessageType_Debug, "trace_file_name: %s\n", g_mib.trace_file_name);
+  return 0;
+}
+
+
+/**
+ * @brief print usage
+ * */
+void Usage(char *app_name)
+{
+  printf("\n\n");
+  printf(" Description: Communicate with kobuki device using serial communication\n");
+  printf(" Version: %s\n", _VERSION_);
+  printf(" Author: wuppu\n");
+  printf(" Email: wndud1640@gmail.com\n");
+
+  printf("\n");
+  printf(" [USAGE]\n");
+  printf(" %s <OPTIONS>\n", app_name);
+  printf(" --ip <ip_address>         Arduino IPv4 address. If not specified, set to 192.168.240.1\n");
+  printf(" --port <port_number>      Arduino UDP port number. If not specified, set to 5555\n");
+  // printf(" --dev <device_name>       Device name in \"/dev/\" directory\n");
+  printf(" --baud <baud_rate>        Serial port baud rate. if not specified, set to 115200\n");
+  printf("     1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 bits per seconds\n");
+  printf(" --script <script_file>    Script file name. If not specified, set to ./script.txt\n");
+  printf(" --lead <lead_ms>         Commands are sent lead_ms ahead and executed on time by the bridge. If not specified, set to %d\n", SYNC_LEAD_DEFAULT_MS);
+  printf("     0: execute commands as soon as they arrive (no clock synchronisation)\n");
+  printf(" --ready-timeout <ms>      Wait for the bridge ack and KOBUKI feedback before the script. If not specified, set to %d\n", READY_TIMEOUT_DEFAULT_MS);
+  printf("     0: start the script without checking the link\n");
+  printf(" --boot-led                Blink the LEDs for 3 seconds before the script\n");
+  printf(" --reflex <mask>           Stop as soon as KOBUKI reports these sensors. If not specified, set to 0x%X\n", REFLEX_DEFAULT_MASK);
+  printf("     0x1: bumper, 0x2: cliff, 0x4: wheel drop, 0: disable\n");
+  printf(" --reflex-backoff <mm/s>   Back off at this speed for %dms instead of stopping. If not specified, set to 0\n", REFLEX_BACKOFF_TIME_MS);
+  printf(" --link-policy <file>      Link quality thresholds and actions (see README). If not specified, use the defaults\n");
+  printf(" --profile <file>          Per-robot kinematic profile for the script timing. If not specified, use the defaults\n");
+  printf(" --calibrate <file>        Drive calibration patterns instead of the script and write the fitted profile.\n");
+  printf("     Moves about 1m forward and turns, needs encoder and gyro feedback\n");
+  printf(" --shm <name>              Create the shared memory region /dev/shm/<name> for other processes and\n");
+  printf("     apply their set-points after the script until a termination signal\n");
+  printf(" --reload <mode>           Watch the script file and run the new version when it is saved, without restarting\n");
+  printf("     segment: after the current command, stop: stop the current command immediately\n");
+  printf(" --virtual                 Run the script on a virtual clock against a simulated bridge, without waiting\n");
+  printf(" --timeline <file>         Write the frame timeline of a --virtual run as CSV\n");
+  printf(" --sim-config <file>       Simulated bridge settings for --virtual (see README). If not specified, use the defaults\n");
+  printf(" --trace <file>            Write per-command spans as a Chrome trace (open in Perfetto)\n");
+  printf(" --dbg <dbg_level>         Print log level. If not specified, set to 1\n");
+  printf("     0: None, 1: Error, 2: Event, 3: Info, 4: Debug\n");
+  printf("\n\n");
+}
+
+
+/**
+ * @brief bridge 와 KOBUKI 의 연결을 확인한다.
+ * @param[in] timeout_ms 최대 대기 시간 ms 단위, 0: 확인하지 않음
+ * @retval 0: 성공
+ * @retval -1: 실패 (bridge 응답 없음)
+ * @details stop 명령과 request extra 명령의 ack 로 bridge 를, 버전 feedback 으로 KOBUKI 를 확인한다.
+ *          KOBUKI feedback 이 없어도 bridge 가 응답하면 경고 후 진행한다.
+ * */
+static int WaitReady(int timeout_ms)
+{
+  if (timeout_ms <= 0) {
+    return 0;
+  }
+
+  uint64_t ready_start_us = GetTimeUs();
+  uint64_t deadline_us = ready_start_us + (uint64_t)timeout_ms * 1000;
+  int link_ms = -1;
+  int base_ms = -1;
+
+  KOBUKI_ControlSpeed(g_mib.device, 0, 0);
+  KOBUKI_RequestExtra(g_mib.device, REQUEST_EXTRA_HARDWARE_VERSION | REQUEST_EXTRA_FIRMWARE_VERSION);
+
+  while (true) {
+    uint64_t now_us = GetTimeUs();
+    if (link_ms < 0 && IsReliableSettled()) {
+      link_ms = (int)((now_us - ready_start_us) / 1000);
+    }
+    if (base_ms < 0 && (g_mib.feedback.valid & kFeedbackType_Version)) {
+      base_ms = (int)((now_us - ready_start_us) / 1000);
+    }
+    bool sync_ready = (g_mib.sync_lead_ms <= 0 || g_mib.sync.valid);
+    if ((link_ms >= 0 && base_ms >= 0 && sync_ready) || now_us >= deadline_us) {
+      break;
+    }
+    WaitOrTerminate(deadline_us, kEventType_Ack | kEventType_Feedback | kEventType_Sync);
+  }
+
+  if (link_ms < 0) {
+    PrintLog(kMessageType_Error, "Fail to connect bridge - no ack in %dms\n", timeout_ms);
+    return -1;
+  }
+  if (base_ms < 0) {
+    PrintLog(kMessageType_Error, "Fail to receive KOBUKI feedback - continue with bridge link only\n");
+  }
+  else {
+    PrintLog(kMessageType_Info, "KOBUKI version - hardware: %d.%d.%d, firmware: %d.%d.%d\n",
+            g_mib.feedback.hardware_version[0], g_mib.feedback.hardware_version[1], g_mib.feedback.hardware_version[2],
+            g_mib.feedback.firmware_version[0], g_mib.feedback.firmware_version[1], g_mib.feedback.firmware_version[2]);
+  }
+  PrintLog(kMessageType_Pass, "Success to check link - bridge: %dms, base: %dms, sync: %d\n", link_ms, base_ms, g_mib.sync.valid);
+  return 0;
+}
+
+/**
+ * @brief reflex 로 중단된 speed 명령을 정리한다.
+ * @param[in] lead_us 명령 전송 시각과 실행 시각의 차이
+ * @return 다음 명령의 실행 시각
+ * @details stop(back-off) 은 수신 경로에서 이미 전송되었다. back-off 중이면 일정 시간 후 stop 을 전송하고,
+ *          남은 speed 구간은 건너뛴 뒤 현재 시각부터 다시 계획한다.
+ * */
+static uint64_t RecoverReflex(uint64_t lead_us)
+{
+  if (g_mib.reflex.backoff_speed != 0) {
+    WaitOrTerminate(g_mib.reflex.last_tx_us + REFLEX_BACKOFF_TIME_MS * 1000, kEventType_None);
+    SetCommandTime(0);
+    KOBUKI_ControlSpeed(g_mib.device, 0, 0);
+  }
+  PrintLog(kMessageType_Info, "Skip speed command by reflex - type: 0x%X\n", g_mib.reflex.last_type);
+  return GetTimeUs() + lead_us;
+}
+
+/**
+ * @brief 어플리케이션 시작부터 첫 번째 script 명령까지 걸린 시간을 출력한다.
+ * */
+static void ReportFirstCommand(void)
+{
+  static bool reported = false;
+
+  if (reported) {
+    return;
+  }
+  reported = true;
+  PrintLog(kMessageType_Pass, "Time to first command: %dms\n", (int)((GetTimeUs() - g_mib.start_us) / 1000));
+}
+
+
+/**
+ * @brief script 명령을 순차 실행한다.
+ * @details 각 명령은 계획된 실행 시각보다 lead 만큼 먼저 전송되고, bridge 가 실행 시각에 적용한다.
+ *          속도 명령은 profile 의 지연만큼 먼저 실행해서 바퀴가 계획된 시각에 움직이게 한다.
+ *          --reload 로 새 script 가 준비되면 명령 사이에서 교체하고 처음부터 실행한다.
+ *          stop 모드에서는 실행 중인 명령을 바로 멈추고 교체한다.
+ * */
+static void ExecuteScript(void)
+{
+  EventType reload_mask = (g_mib.reload_mode == kReloadMode_Stop) ? kEventType_Reload : kEventType_None;
+  uint64_t lead_us = GetSyncLeadUs();
+  uint64_t latency_us = (uint64_t)g_mib.profile.latency_ms * 1000;
+  uint64_t plan_us = GetTimeUs() + lead_us + latency_us;
+  int ret;
+
+  ResetOdometry();
+  for (int i = 0; i < g_mib.script->lines_size; i++) {
+    if (SwapScript()) {
+      /* 이전 script 에서 남은 reload 이벤트로 새 script 가 멈추지 않도록 지운다. */
+      g_mib.events &= ~kEventType_Reload;
+      ResetOdometry();
+      uint64_t now_plan_us = GetTimeUs() + lead_us + latency_us;
+      plan_us = (plan_us > now_plan_us) ? plan_us : now_plan_us;
+      i = -1;
+      continue;
+    }
+    ret = 0;
+    switch (g_mib.script->lines[i].type) {
+      case kCommandType_None:
+        continue;
+      case kCommandType_LED:
+        ret = WaitOrTerminate(plan_us - lead_us, reload_mask);
+        if (ret > 0) {
+          break;
+        }
+        ReportFirstCommand();
+        g_mib.command_id++;
+        TRACE_BEGIN(trace_led_span);
+        SetCommandTime(plan_us);
+        KOBUKI_ControlLED(g_mib.device, g_mib.script->lines[i].led_num, g_mib.script->lines[i].color);
+        TRACE_END(trace_led_span, "script_led");
+        break;
+      case kCommandType_Sleep:
+        plan_us += (uint64_t)g_mib.script->lines[i].delay * 1000;
+        break;
+      case kCommandType_Speed:
+        ret = WaitOrTerminate(plan_us - latency_us - lead_us, reload_mask);
+        if (ret > 0) {
+          break;
+        }
+        ReportFirstCommand();
+        /* 센서가 눌린 채로 전진하지 않는다. 후진은 허용한다. */
+        if ((g_mib.reflex.active != kReflexType_None) && (g_mib.script->lines[i].speed > 0)) {
+          PrintLog(kMessageType_Info, "Skip speed command by reflex - active: 0x%X\n", g_mib.reflex.active);
+          break;
+        }
+        g_mib.command_id++;
+        g_mib.events &= ~kEventType_Reflex;
+        TRACE_BEGIN(trace_speed_span);
+        SetCommandTime(plan_us - latency_us);
+        KOBUKI_ControlSpeed(g_mib.device, g_mib.script->lines[i].speed, g_mib.script->lines[i].radius);
+        TRACE_END(trace_speed_span, "script_speed");
+
+        /* link 상태로 속도가 제한되었으면 같은 거리를 가도록 구간을 늘린다. */
+        uint64_t move_us = (uint64_t)g_mib.script->lines[i].move_time * 1000;
+        int applied_speed = g_mib.link.applied_speed;
+        if (applied_speed != 0 && applied_speed != g_mib.script->lines[i].speed) {
+          uint64_t limited_us = move_us * (uint64_t)abs(g_mib.script->lines[i].speed) / (uint64_t)abs(applied_speed);
+          PrintLog(kMessageType_Info, "Extend segment by link speed limit - speed: %d -> %d, move_time: %dms -> %dms\n",
+                  g_mib.script->lines[i].speed, applied_speed, (int)(move_us / 1000), (int)(limited_us / 1000));
+          move_us = limited_us;
+        }
+        plan_us += move_us;
+        ret = WaitOrTerminate(plan_us - latency_us - lead_us, kEventType_Reflex | reload_mask);
+        if (ret > 0 && (ret & kEventType_Reflex)) {
+          plan_us = RecoverReflex(lead_us + latency_us);
+          ret = 0;
+          break;
+        }
+        if (ret > 0) {
+          break;
+        }
+        TRACE_BEGIN(trace_stop_span);
+        SetCommandTime(plan_us - latency_us);
+				KOBUKI_ControlSpeed(g_mib.device, 0, 0);
+        TRACE_END(trace_stop_span, "script_stop");
+        break;
+      case kCommandType_Waypoint: {
+        /* 연속된 waypoint 는 멈추지 않고 한 번에 따라간다. 끝나는 시각을 알 수 없으므로 이후 계획을 다시 세운다. */
+        int waypoints_size = 1;
+        while (i + waypoints_size < g_mib.script->lines_size && g_mib.script->lines[i + waypoints_size].type == kCommandType_Waypoint) {
+          waypoints_size++;
+        }
+        ret = WaitOrTerminate(plan_us - latency_us - lead_us, reload_mask);
+        if (ret > 0) {
+          break;
+        }
+        ReportFirstCommand();
+        if (g_mib.reflex.active != kReflexType_None) {
+          PrintLog(kMessageType_Info, "Skip waypoints by reflex - active: 0x%X\n", g_mib.reflex.active);
+          i += waypoints_size - 1;
+          break;
+        }
+        g_mib.command_id++;
+        g_mib.events &= ~kEventType_Reflex;
+        ret = FollowWaypoints(&g_mib.script->lines[i], waypoints_size);
+        if (ret < 0) {
+          /* 위치를 모르는 채로 나머지 script 를 실행하지 않는다. stop 을 확인하고 실패로 종료한다. */
+          TerminateEvent(-1);
+        }
+        if (ret > 0 && (ret & kEventType_Terminate)) {
+          TerminateEvent(g_mib.terminate_signal);
+        }
+        i += waypoints_size - 1;
+        plan_us = (ret > 0 && (ret & kEventType_Reflex)) ? RecoverReflex(lead_us + latency_us) : GetTimeUs() + lead_us + latency_us;
+        break;
+      }
+    }
+
+    /* stop 모드: 실행 중인 명령을 바로 멈추고, 다음 반복에서 새 script 로 교체한다. */
+    if (ret > 0 && (ret & kEventType_Reload)) {
+      PrintLog(kMessageType_Info, "Stop script for reload - line: %d\n", i);
+      SetCommandTime(0);
+      KOBUKI_ControlSpeed(g_mib.device, 0, 0);
+      plan_us = GetTimeUs() + lead_us + latency_us;
+    }
+  }
+  WaitOrTerminate(plan_us, reload_mask);
+  SetCommandTime(0);
+}
+
+
+int main(int argc, char* argv[])
+{
+  g_mib.log_level = kMessageType_Error;
+  g_mib.start_us = GetTimeUs();
+
+  g_mib.device = -1;
+  g_mib.socket = -1;
+  g_mib.signal_event_fd = -1;
+  g_mib.shared_event_fd = -1;
+  g_mib.reload_event_fd = -1;
+  g_mib.script = &g_mib.scripts[0];
+  KOBUKI_EncodeSpeed(g_mib.stop_frame, 0, 0);
+
+  /* application terminate handler 등록 (SIGINT, SIGTERM, SIGHUP 은 핸들러가 eventfd 로 event loop 에 알린다) */
+  if (InitSignal(&g_mib.signal_event_fd) < 0) {
+    PrintLog(kMessageType_Error, "Fail to initialize signal\n");
+  }
+  struct sigaction sig_action;
+  memset(&sig_action, 0x00, sizeof(sig_action));
+  sig_action.sa_handler = CrashEvent;
+  sigemptyset(&sig_action.sa_mask);
+  sig_action.sa_flags = 0;
+  if (sigaction(SIGSEGV, &sig_action, NULL) != 0) {
+    PrintLog(kMessageType_Error, "Fail to sigaction - SIGSEGV\n");
+  }
+
+  /* help 출력 */
+  // if (argc == 1) {
+  //   Usage(argv[0]);
+  //   TerminateEvent(-1);
+  // }
+
+  /* input parameters 처리 */
+  int ret = ParseInputParameter(argc, argv);
+  if (ret < 0) {
+    Usage(argv[0]);
+    TerminateEvent(-1);
+  }
+  if (g_mib.trace_file_name[0] != '\0') {
+    StartTrace();
+  }
+  /* kinematic profile, script file 처리 */
+  InitProfile(&g_mib.profile);
+  if (g_mib.profile_file_name[0] != '\0' && LoadProfile(g_mib.profile_file_name, &g_mib.profile) < 0) {
+    TerminateEvent(-1);
+  }
+  if (g_mib.calibrate_file_name[0] == '\0') {
+    ret = ParseScriptCommand(g_mib.script_file_name, &g_mib.profile, g_mib.script);
+    if (ret < 0) {
+      TerminateEvent(-1);
+    }
+  }
+
+  if (g_mib.clock_type == kClockType_Virtual) {
+    struct SimConfig sim_config;
+    InitSimConfig(&sim_config);
+    if (g_mib.sim_config_file_name[0] != '\0' && LoadSimConfig(g_mib.sim_config_file_name, &sim_config) < 0) {
+      TerminateEvent(-1);
+    }
+    SetClock(kClockType_Virtual);
+    g_mib.socket = SIM_SOCKET;
+    ret = InitSim(&g_mib.sim, &sim_config, g_mib.timeline_file_name);
+  }
+  else {
+    ret = InitUDP(g_mib.server_ip_addr, g_mib.server_port_num, &g_mib.server_addr, &g_mib.socket);
+  }
+  if (ret < 0) {
+    TerminateEvent(-1);
+  }
+  InitReliable(&g_mib.reliable);
+  InitSync(&g_mib.sync, g_mib.sync_lead_ms);
+  InitReflex(&g_mib.reflex, g_mib.reflex_mask, g_mib.reflex_backoff_speed);
+  InitLink(&g_mib.link);
+  if (g_mib.link_policy_file_name[0] != '\0' && LoadLinkPolicy(g_mib.link_policy_file_name, &g_mib.link.policy) < 0) {
+    TerminateEvent(-1);
+  }
+  if (g_mib.shared_name[0] != '\0') {
+    if (OpenSharedRegion(g_mib.shared_name, true, &g_mib.shared) < 0 ||
+        StartSharedNotify(g_mib.shared, &g_mib.shared_event_fd) < 0) {
+      TerminateEvent(-1);
+    }
+  }
+  if (g_mib.reload_mode != kReloadMode_None && g_mib.calibrate_file_name[0] == '\0' &&
+      StartScriptWatch(g_mib.script_file_name, &g_mib.reload_event_fd) < 0) {
+    TerminateEvent(-1);
+  }
+
+  /* bridge, KOBUKI 연결 확인 */
+  KOBUKI_ControlLED(g_mib.device, 1, kLEDColor_Red);
+  KOBUKI_ControlLED(g_mib.device, 2, kLEDColor_None);
+  ret = WaitReady(g_mib.ready_timeout_ms);
+  if (ret < 0) {
+    TerminateEvent(-1);
+  }
+
+  /* 초기 동작 LED 점등 (3초) */
+  if (g_mib.boot_led) {
+    KOBUKI_ControlLED(g_mib.device, 1, kLEDColor_None);
+    WaitOrTerminate(GetTimeUs() + 1000000, kEventType_None);
+    KOBUKI_ControlLED(g_mib.device, 1, kLEDColor_Red);
+    WaitOrTerminate(GetTimeUs() + 1000000, kEventType_None);
+    KOBUKI_ControlLED(g_mib.device, 2, kLEDColor_Red);
+    WaitOrTerminate(GetTimeUs() + 1000000, kEventType_None);
+  }
+  KOBUKI_ControlLED(g_mib.device, 1, kLEDColor_Green);
+  KOBUKI_ControlLED(g_mib.device, 2, kLEDColor_Green);
+
+  /* calibration: script 대신 측정 동작을 실행하고 profile 을 쓴다. */
+  if (g_mib.calibrate_file_name[0] != '\0' && RunCalibration(g_mib.calibrate_file_name) < 0) {
+    TerminateEvent((g_mib.events & kEventType_Terminate) ? g_mib.terminate_signal : -1);
+  }
+
+  /* script 내용 순차 처리 */
+  ExecuteScript();
+
+  /* 공유 메모리 명령, script reload 처리: 종료 시그널을 받을 때까지 */
+  if (g_mib.shared != NULL || g_mib.reload_mode != kReloadMode_None) {
+    if (g_mib.shared != NULL) {
+      PrintLog(kMessageType_Pass, "Success to start shared memory commands - name: %s\n", g_mib.shared_name);
+      UpdateSharedState();
+    }
+    while (true) {
+      ret = WaitOrTerminate(GetTimeUs() + SHARED_SERVE_INTERVAL_MS * 1000, kEventType_Shared | kEventType_Reload);
+      if (ret > 0 && (ret & kEventType_Shared)) {
+        ApplySharedCommand();
+      }
+      if (SwapScript()) {
+        g_mib.events &= ~kEventType_Reload;
+        ExecuteScript();
+      }
+    }
+  }
+
+  /* script 내용 처리 - LED off */
+  KOBUKI_ControlLED(g_mib.device, 1, kLEDColor_None);
+  KOBUKI_ControlLED(g_mib.device, 2, kLEDColor_None);  
+  KOBUKI_ControlSpeed(g_mib.device, 0, 0);
+
+  /* 마지막 상태가 bridge 에 전달될 때까지 재전송 */
+  uint64_t flush_deadline_us = GetTimeUs() + RELIABLE_FLUSH_TIMEOUT_MS * 1000;
+  while (IsReliableSettled() == false && GetTimeUs() < flush_deadline_us) {
+    WaitOrTerminate(flush_deadline_us, kEventType_Ack);
+  }
+  PrintReliableStatus();
+  PrintSyncStatus();
+  PrintReflexStatus();
+  PrintLinkStatus();
+  PrintLog(kMessageType_Info, "Feedback status - packet: %u, error: %u\n", g_mib.feedback.packet_count, g_mib.feedback.error_count);
+  if (g_mib.sim.initialized) {
+    CloseSim();
+  }
+  WriteTrace(g_mib.trace_file_name);
+
+#if 0
+  unsigned char buf[1000];
+  memset(buf, 0x00, sizeof(buf));
+
+
+  while (true) {
+    int recv_len = read(g_mib.device, buf, sizeof(buf));
+    if (recv_len < 0) {
+      continue;
+      PrintLog(kMessageType_Error, "Fail to read %s serial port\n", g_mib.device_name);
+      // TerminateEvent(-1);
+    }
+
+    PrintLog(kMessageType_Debug, "recv_len: %d\n", recv_len);
+    PrintLog(kMessageType_Debug, "recv: \n");
+    for (int i = 0; i < recv_len; i++) {
+
+      if (i != 0 && i % 8 == 0) {
+        if (i != 0 && i % 16 == 0) {
+          printf("\n");
+        }
+        else {
+          printf(" ");
+        }
+      }
+      if (i % 16 == 0) {
+        printf("%06X ", i);
+      }
+      printf("%02X ", buf[i]);
+    }
+    printf("\n");
+  }
+
+  PrintLog(kMessageType_Pass, "Done\n");
+  close(g_mib.device); //close serial port
+#endif
+  return 0;
+}
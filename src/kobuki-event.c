@@ -0,0 +1,336 @@
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+#include "kobuki.h"
+
+static uint64_t g_virtual_time_us; ///< kClockType_Virtual 의 현재 시각
+
+/* 종료 시그널 핸들러가 기록한다. */
+static int g_signal_event_fd = -1;
+static int g_signal_signo; ///< 처음 전달된 종료 시그널, 0: 없음
+static uint64_t g_signal_us; ///< 처음 전달된 시각 (monotonic)
+static const int g_terminate_signals[] = { SIGINT, SIGTERM, SIGHUP };
+
+/**
+ * @brief monotonic 현재 시각 (clock 설정과 무관한 실제 시각)
+ * @return us 단위 시각
+ */
+uint64_t GetMonotonicTimeUs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief wake_us 까지 fd 를 기다린다.
+ */
+static int PollMonotonic(struct pollfd *fds, int fds_size, uint64_t wake_us)
+{
+  uint64_t now_us = GetMonotonicTimeUs();
+  int timeout_ms = (wake_us > now_us) ? (int)((wake_us - now_us + 999) / 1000) : 0;
+
+  return poll(fds, fds_size, timeout_ms);
+}
+
+static uint64_t GetVirtualTimeUs(void)
+{
+  return g_virtual_time_us;
+}
+
+/**
+ * @brief 대기 없이 시뮬레이션 bridge 의 다음 event 또는 wake_us 로 시각을 옮긴다.
+ * @details 실제 fd (종료 시그널 등)는 기다리지 않고 확인만 한다.
+ *          SIM_SOCKET 은 음수라서 poll() 이 무시하고, 시뮬레이션 event 가 있으면 수신 가능으로 표시한다.
+ */
+static int PollVirtual(struct pollfd *fds, int fds_size, uint64_t wake_us)
+{
+  int ret = poll(fds, fds_size, 0);
+  if (ret != 0) {
+    return ret;
+  }
+
+  uint64_t due_us = SimNextDueUs();
+  if (due_us <= wake_us) {
+    if (due_us > g_virtual_time_us) {
+      g_virtual_time_us = due_us;
+    }
+    for (int i = 0; i < fds_size; i++) {
+      if (fds[i].fd == SIM_SOCKET) {
+        fds[i].revents = POLLIN;
+        return 1;
+      }
+    }
+  }
+  if (wake_us > g_virtual_time_us) {
+    g_virtual_time_us = wake_us;
+  }
+  return 0;
+}
+
+static const struct ClockOps g_monotonic_clock = { "monotonic", GetMonotonicTimeUs, PollMonotonic };
+static const struct ClockOps g_virtual_clock = { "virtual", GetVirtualTimeUs, PollVirtual };
+
+/**
+ * @brief event loop 와 script 실행에 사용할 시계를 설정한다.
+ * @param[in] clock_type 시계 종류, kClockType_Virtual 은 현재 시각에서 시작한다
+ */
+void SetClock(ClockType clock_type)
+{
+  if (clock_type == kClockType_Virtual) {
+    g_virtual_time_us = GetTimeUs();
+    g_mib.clock = &g_virtual_clock;
+  }
+  else {
+    g_mib.clock = &g_monotonic_clock;
+  }
+  g_mib.clock_type = clock_type;
+}
+
+/**
+ * @brief 현재 시각
+ * @return us 단위 시각, SetClock() 으로 설정한 시계 기준
+ */
+uint64_t GetTimeUs(void)
+{
+  if (g_mib.clock == NULL) {
+    return GetMonotonicTimeUs();
+  }
+  return g_mib.clock->now_us();
+}
+
+/**
+ * @brief 종료 시그널 핸들러, 전달 시각을 기록하고 eventfd 로 event loop 를 깨운다.
+ * @param[in] signum 시그널 번호
+ * @details async-signal-safe 함수만 사용한다. stop 전송은 HandleSignal() 에서 한다.
+ */
+static void NotifySignal(int signum)
+{
+  int saved_errno = errno;
+  uint64_t count = 1;
+
+  if (__atomic_load_n(&g_signal_signo, __ATOMIC_SEQ_CST) == 0) {
+    __atomic_store_n(&g_signal_us, GetMonotonicTimeUs(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_signal_signo, signum, __ATOMIC_SEQ_CST);
+  }
+  if (write(g_signal_event_fd, &count, sizeof(count)) != sizeof(count)) {
+    /* counter 가 가득 차도 이미 읽을 수 있는 상태다. */
+  }
+  errno = saved_errno;
+}
+
+/**
+ * @brief 종료 시그널(SIGINT, SIGTERM, SIGHUP)을 eventfd 로 받도록 설정한다.
+ * @param[out] signal_event_fd 종료 시그널이 전달되면 읽을 수 있게 되는 eventfd
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ * @details 핸들러는 전달 시각만 기록하고, 시그널은 WaitEvent() 에서 처리된다.
+ *          signalfd 는 읽을 때까지 전달 시각을 알 수 없어서 stop 지연을 실제보다 짧게 잰다.
+ */
+int InitSignal(int *signal_event_fd)
+{
+  struct sigaction action;
+
+  *signal_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (*signal_event_fd < 0) {
+    PrintLog(kMessageType_Error, "Fail to create eventfd - signal_event_fd: %d\n", *signal_event_fd);
+    return -1;
+  }
+  g_signal_event_fd = *signal_event_fd;
+
+  memset(&action, 0x00, sizeof(action));
+  action.sa_handler = NotifySignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  for (size_t i = 0; i < sizeof(g_terminate_signals) / sizeof(g_terminate_signals[0]); i++) {
+    sigaddset(&action.sa_mask, g_terminate_signals[i]);
+  }
+  for (size_t i = 0; i < sizeof(g_terminate_signals) / sizeof(g_terminate_signals[0]); i++) {
+    if (sigaction(g_terminate_signals[i], &action, NULL) != 0) {
+      PrintLog(kMessageType_Error, "Fail to sigaction - signal: %d\n", g_terminate_signals[i]);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief 호출한 thread 에서 종료 시그널을 막는다.
+ * @param[out] old_mask 이전 signal mask, pthread_sigmask(SIG_SETMASK, old_mask, NULL) 로 되돌린다.
+ * @details helper thread 는 만든 thread 의 mask 를 물려받는다. pthread_create() 앞뒤로 사용하면
+ *          종료 시그널 핸들러가 main thread 에서만 실행된다.
+ */
+void BlockTerminateSignals(sigset_t *old_mask)
+{
+  sigset_t mask;
+
+  sigemptyset(&mask);
+  for (size_t i = 0; i < sizeof(g_terminate_signals) / sizeof(g_terminate_signals[0]); i++) {
+    sigaddset(&mask, g_terminate_signals[i]);
+  }
+  pthread_sigmask(SIG_BLOCK, &mask, old_mask);
+}
+
+/**
+ * @brief 종료 시그널이 전달되었으면 즉시 stop 명령을 전송한다.
+ * @details stop_latency_us 는 핸들러가 기록한 전달 시각부터 잰다 (virtual clock 에서도 실제 시각).
+ */
+static void HandleSignal(void)
+{
+  uint64_t count;
+
+  if (read(g_mib.signal_event_fd, &count, sizeof(count)) != sizeof(count)) {
+    return;
+  }
+  int signo = __atomic_load_n(&g_signal_signo, __ATOMIC_SEQ_CST);
+  if (signo == 0) {
+    return;
+  }
+  if (g_mib.terminate_signal == 0) {
+    g_mib.terminate_signal = signo;
+    g_mib.terminate_signal_us = __atomic_load_n(&g_signal_us, __ATOMIC_SEQ_CST);
+    KOBUKI_EmergencyStop();
+    g_mib.stop_latency_us = (int)(GetMonotonicTimeUs() - g_mib.terminate_signal_us);
+  }
+  g_mib.events |= kEventType_Terminate;
+}
+
+/**
+ * @brief 수신한 UDP frame 을 frame type 에 따라 처리한다.
+ * @param[in] buf 수신한 frame
+ * @param[in] len frame 길이
+ * @param[in] now_us 수신 시각
+ */
+static void HandleUDPFrame(const uint8_t *buf, size_t len, uint64_t now_us)
+{
+  const struct ReliableHeader *header = (const struct ReliableHeader *)buf;
+
+  if (len < sizeof(struct ReliableHeader) || header->magic != RELIABLE_MAGIC) {
+    PrintLog(kMessageType_Debug, "Drop unknown UDP frame - len: %d\n", (int)len);
+    return;
+  }
+
+  switch (header->frame_type) {
+    case kFrameType_Ack:
+      if (HandleReliableAck(buf, len, now_us) == 0) {
+        g_mib.link.last_rx_us = now_us;
+        g_mib.events |= kEventType_Ack;
+      }
+      break;
+    case kFrameType_Feedback:
+      if (HandleFeedback(buf, len, now_us) >= 0) {
+        g_mib.link.last_rx_us = now_us;
+        g_mib.events |= kEventType_Feedback;
+        UpdateSharedState();
+      }
+      break;
+    case kFrameType_SyncResponse:
+      if (HandleSyncResponse(buf, len, now_us) == 0) {
+        g_mib.link.last_rx_us = now_us;
+        g_mib.events |= kEventType_Sync;
+      }
+      break;
+    default:
+      PrintLog(kMessageType_Debug, "Drop UDP frame - frame_type: %d\n", header->frame_type);
+      break;
+  }
+}
+
+/**
+ * @brief 주어진 시간 동안 수신 frame 과 재전송을 처리하며 대기한다.
+ * @param[in] wait_ms 대기 시간 ms 단위
+ * @param[in] wake_mask 대기를 중단시킬 이벤트
+ * @return 대기를 중단시킨 이벤트, 시간이 다 지나면 0
+ * @retval 음수: 실패
+ */
+int WaitEvent(int wait_ms, EventType wake_mask)
+{
+  return WaitEventUntil(GetTimeUs() + (uint64_t)(wait_ms > 0 ? wait_ms : 0) * 1000, wake_mask);
+}
+
+/**
+ * @brief 주어진 시각까지 수신 frame, 재전송, 시계 동기화를 처리하며 대기한다.
+ * @param[in] deadline_us 대기 종료 시각
+ * @param[in] wake_mask 대기를 중단시킬 이벤트
+ * @return 대기를 중단시킨 이벤트, 시간이 다 지나면 0
+ * @retval 음수: 실패
+ */
+int WaitEventUntil(uint64_t deadline_us, EventType wake_mask)
+{
+  uint8_t buf[UDP_PACKET_MAX_SIZE];
+
+  while (true) {
+    uint64_t now_us = GetTimeUs();
+
+    EventType events = g_mib.events & wake_mask;
+    if (events != 0) {
+      g_mib.events &= ~(events & ~kEventType_Terminate);
+      return (int)events;
+    }
+
+    int next_ms = ServiceReliable(now_us);
+    int sync_ms = ServiceSync(now_us);
+    if (sync_ms >= 0 && (next_ms < 0 || sync_ms < next_ms)) {
+      next_ms = sync_ms;
+    }
+    int link_ms = ServiceLink(now_us);
+    if (link_ms >= 0 && (next_ms < 0 || link_ms < next_ms)) {
+      next_ms = link_ms;
+    }
+    if (now_us >= deadline_us) {
+      return 0;
+    }
+
+    uint64_t wake_us = deadline_us;
+    if (next_ms >= 0 && now_us + (uint64_t)next_ms * 1000 < wake_us) {
+      wake_us = now_us + (uint64_t)next_ms * 1000;
+    }
+
+    struct pollfd fds[4];
+    fds[0].fd = g_mib.signal_event_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = g_mib.socket;
+    fds[1].events = POLLIN;
+    fds[2].fd = g_mib.shared_event_fd;
+    fds[2].events = POLLIN;
+    fds[3].fd = g_mib.reload_event_fd;
+    fds[3].events = POLLIN;
+    const struct ClockOps *clock = (g_mib.clock != NULL) ? g_mib.clock : &g_monotonic_clock;
+    int ret = clock->poll(fds, 4, wake_us);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      PrintLog(kMessageType_Error, "Fail to poll - ret: %d\n", ret);
+      return -1;
+    }
+
+    /* 종료 시그널을 수신 frame 보다 먼저 처리한다. */
+    if (fds[0].revents & POLLIN) {
+      HandleSignal();
+    }
+    if (fds[1].revents & POLLIN) {
+      int len;
+      while ((len = RecvUDPMessage(g_mib.socket, (char *)buf, sizeof(buf))) > 0) {
+        g_mib.rx_monotonic_us = GetMonotonicTimeUs();
+        TRACE_BEGIN(trace_span);
+        HandleUDPFrame(buf, (size_t)len, GetTimeUs());
+        TRACE_END_ID(trace_span, "rx_decode", 0);
+      }
+    }
+    if (fds[2].revents & POLLIN) {
+      uint64_t count;
+      if (read(g_mib.shared_event_fd, &count, sizeof(count)) == sizeof(count)) {
+        g_mib.events |= kEventType_Shared;
+      }
+    }
+    if (fds[3].revents & POLLIN) {
+      uint64_t count;
+      if (read(g_mib.reload_event_fd, &count, sizeof(count)) == sizeof(count)) {
+        g_mib.events |= kEventType_Reload;
+      }
+    }
+  }
+}
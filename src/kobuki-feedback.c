@@ -0,0 +1,200 @@
+#include "kobuki.h"
+
+/**
+ * @brief sub-payload 하나를 decode 한다.
+ * @param[in] id sub-payload id
+ * @param[in] data sub-payload 데이터
+ * @param[in] len sub-payload 길이
+ * @param[out] feedback decode 결과
+ * @return decode 한 feedback 종류, 지원하지 않는 sub-payload 는 kFeedbackType_None
+ */
+static FeedbackType ParseFeedbackSubPayload(uint8_t id, const uint8_t *data, uint8_t len, struct FeedbackStatus *feedback)
+{
+  switch (id) {
+    case FEEDBACK_BASIC_SENSOR_ID:
+      if (len < FEEDBACK_BASIC_SENSOR_LEN) {
+        return kFeedbackType_None;
+      }
+      memcpy(&feedback->basic_sensor, data, sizeof(struct BasicSensorFormat));
+      return kFeedbackType_BasicSensor;
+    case FEEDBACK_INERTIAL_SENSOR_ID:
+      if (len < FEEDBACK_INERTIAL_SENSOR_LEN) {
+        return kFeedbackType_None;
+      }
+      memcpy(&feedback->inertial_sensor, data, sizeof(struct InertialSensorFormat));
+      return kFeedbackType_InertialSensor;
+    case FEEDBACK_HARDWARE_VERSION_ID:
+    case FEEDBACK_FIRMWARE_VERSION_ID:
+      if (len < FEEDBACK_VERSION_LEN) {
+        return kFeedbackType_None;
+      }
+      {
+        uint8_t *version = (id == FEEDBACK_HARDWARE_VERSION_ID) ? feedback->hardware_version : feedback->firmware_version;
+        version[0] = data[2];
+        version[1] = data[1];
+        version[2] = data[0];
+      }
+      return kFeedbackType_Version;
+    default:
+      return kFeedbackType_None;
+  }
+}
+
+/**
+ * @brief KOBUKI feedback 패킷을 decode 한다.
+ * @param[in] packet 수신한 패킷 (여러 패킷이 이어져 있어도 된다)
+ * @param[in] packet_len 패킷 길이
+ * @param[out] feedback decode 결과
+ * @return decode 한 feedback 종류
+ * @retval 음수: 올바른 패킷 없음
+ * @details 패킷 구조: 0xAA 0x55 <length> <sub-payload ...> <crc>
+ *          sub-payload 구조: <id> <length> <data ...>
+ */
+int ParseFeedbackPacket(const uint8_t *packet, size_t packet_len, struct FeedbackStatus *feedback)
+{
+  FeedbackType decoded = kFeedbackType_None;
+  bool found = false;
+  size_t pos = 0;
+
+  while (pos + 4 <= packet_len) {
+    if (packet[pos] != HEADER_0 || packet[pos + 1] != HEADER_1) {
+      pos++;
+      continue;
+    }
+
+    size_t payload_len = packet[pos + 2];
+    if (pos + 3 + payload_len + 1 > packet_len) {
+      break;
+    }
+    if (KOBUKI_Checksum(packet + pos, 3 + payload_len) != packet[pos + 3 + payload_len]) {
+      feedback->error_count++;
+      pos += 2;
+      continue;
+    }
+
+    const uint8_t *payload = packet + pos + 3;
+    size_t offset = 0;
+    while (offset + 2 <= payload_len) {
+      uint8_t id = payload[offset];
+      uint8_t len = payload[offset + 1];
+      if (offset + 2 + len > payload_len) {
+        feedback->error_count++;
+        break;
+      }
+      decoded |= ParseFeedbackSubPayload(id, payload + offset + 2, len, feedback);
+      offset += 2 + len;
+    }
+
+    found = true;
+    feedback->packet_count++;
+    pos += 3 + payload_len + 1;
+  }
+
+  if (found == false) {
+    return -1;
+  }
+  feedback->valid |= decoded;
+  return (int)decoded;
+}
+
+/**
+ * @brief Initialize safety reflex
+ * @param[out] reflex reflex 상태
+ * @param[in] mask 사용하는 센서 (kReflexType_*)
+ * @param[in] backoff_speed back-off 속도 mm/s 단위, 0: stop 만 전송
+ */
+void InitReflex(struct ReflexStatus *reflex, ReflexType mask, int backoff_speed)
+{
+  memset(reflex, 0x00, sizeof(struct ReflexStatus));
+  reflex->mask = mask;
+  reflex->backoff_speed = backoff_speed;
+  KOBUKI_EncodeSpeed(reflex->backoff_frame, -backoff_speed, 0);
+}
+
+/**
+ * @brief basic sensor 데이터로 reflex 를 확인하고, 새로 감지된 센서가 있으면 즉시 stop(back-off)을 전송한다.
+ * @param[in] rx_us feedback 수신 시각 (driver 시계)
+ * @details 수신 경로에서 바로 호출되므로 전송 전에는 로그를 출력하지 않는다.
+ *          latency 는 g_mib.rx_monotonic_us (user-space 수신, kernel 도착 시각이 아님)부터 stop 전송까지다.
+ */
+static void CheckReflex(uint64_t rx_us)
+{
+  struct ReflexStatus *reflex = &g_mib.reflex;
+  struct BasicSensorFormat *basic_sensor = &g_mib.feedback.basic_sensor;
+  ReflexType active = kReflexType_None;
+
+  if (basic_sensor->bumper != 0) {
+    active |= kReflexType_Bumper;
+  }
+  if (basic_sensor->cliff != 0) {
+    active |= kReflexType_Cliff;
+  }
+  if (basic_sensor->wheel_drop != 0) {
+    active |= kReflexType_WheelDrop;
+  }
+  active &= reflex->mask;
+
+  ReflexType triggered = active & ~reflex->active;
+  reflex->active = active;
+  if (triggered == kReflexType_None) {
+    return;
+  }
+
+  const uint8_t *frame = (reflex->backoff_speed != 0) ? reflex->backoff_frame : g_mib.stop_frame;
+  SendReliableStateAt(BASE_CONTROL_ID, frame, SPEED_FRAME_LEN, 0);
+  uint64_t tx_monotonic_us = GetMonotonicTimeUs();
+  reflex->last_tx_us = GetTimeUs();
+  g_mib.link.request_speed = 0; // link 상태가 나빠져도 멈추기 전 속도를 다시 보내지 않는다.
+  reflex->last_rx_us = rx_us;
+  reflex->last_type = triggered;
+  reflex->count++;
+
+  /* virtual clock 에서도 실제 처리 시간을 재도록 monotonic 시각으로 잰다. 수신 시각은 recvfrom() 이 돌아온 시각이다. */
+  int latency_us = (int)(tx_monotonic_us - g_mib.rx_monotonic_us);
+  if (latency_us > reflex->latency_max_us) {
+    reflex->latency_max_us = latency_us;
+  }
+  g_mib.events |= kEventType_Reflex;
+
+  PrintLog(kMessageType_Error, "Reflex - type: 0x%X, bumper: 0x%02X, cliff: 0x%02X, wheel_drop: 0x%02X, rx: %lluus, tx: %lluus, latency: %dus\n",
+          triggered, basic_sensor->bumper, basic_sensor->cliff, basic_sensor->wheel_drop,
+          (unsigned long long)(rx_us - g_mib.start_us), (unsigned long long)(reflex->last_tx_us - g_mib.start_us), latency_us);
+}
+
+/**
+ * @brief reflex 통계 출력
+ */
+void PrintReflexStatus(void)
+{
+  PrintLog(kMessageType_Info, "Reflex status - mask: 0x%X, count: %u, latency_max: %dus\n",
+          g_mib.reflex.mask, g_mib.reflex.count, g_mib.reflex.latency_max_us);
+}
+
+/**
+ * @brief bridge 가 전달한 feedback frame 을 처리한다.
+ * @param[in] buf 수신한 feedback frame
+ * @param[in] len frame 길이
+ * @param[in] now_us 수신 시각
+ * @return decode 한 feedback 종류
+ * @retval 음수: 잘못된 frame
+ */
+int HandleFeedback(const uint8_t *buf, size_t len, uint64_t now_us)
+{
+  const struct ReliableHeader *header = (const struct ReliableHeader *)buf;
+
+  if (len <= sizeof(struct ReliableHeader) || header->session != g_mib.reliable.session) {
+    return -1;
+  }
+
+  int ret = ParseFeedbackPacket(buf + sizeof(struct ReliableHeader), len - sizeof(struct ReliableHeader), &g_mib.feedback);
+  if (ret < 0) {
+    PrintLog(kMessageType_Debug, "Fail to parse feedback packet - len: %d\n", (int)len);
+    return -1;
+  }
+  if (ret & kFeedbackType_BasicSensor) {
+    CheckReflex(now_us);
+    UpdateOdometry(ret, now_us);
+  }
+  g_mib.feedback.last_update_us = now_us;
+  return ret;
+}
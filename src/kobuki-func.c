@@ -1,453 +1,686 @@
-// C library headers
-#include <stdio.h>
-#include <stdint.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdarg.h>
-#include <signal.h>
-#include <unistd.h>
-#include <stdbool.h>
-#include <netinet/in.h>
-#include <math.h>
-
-// Linux headers
-#include <fcntl.h> // Contains file controls like O_RDWR
-#include <termios.h> // Contains POSIX terminal control definitions
-#include <unistd.h> // write(), read(), close()
-
-// User headers
-#include "kobuki.h"
-
-#define _USE_MATH_DEFINES
-
-/**
- * @brief hex dump 출력
- * @param[in] msg_type 출력 메시지의 타입
- * @param[in] command_type 커맨드의 타입
- * @param[in] format 출력 메시지 prefix
- * @param[in] command 커맨드의 구조체 포인터
- * */
-void PrintHexDump(MessageType msg_type, CommandType command_type, const char *format, void *command)
-{
-  struct LEDMessageFormat *led_msg;
-  struct SpeedMessageFormat *speed_msg;
-
-  printf(">> ");
-  switch (msg_type) {
-    case kMessageType_Error:
-      printf("\x1b[1;31m");
-      break;
-    case kMessageType_Pass:
-      printf("\x1b[1;32m");
-      break;
-    case kMessageType_Debug:
-      printf("\x1b[1;35m");
-      break;
-    case kMessageType_Info:
-      printf("\x1b[0m");
-      break;
-  }
-
-  unsigned char *ptr;
-  printf("%s: ", format);
-  switch (command_type) {
-    case kCommandType_LED:
-      led_msg = (struct LEDMessageFormat *)command;
-      ptr = (unsigned char *)led_msg;
-      for (size_t i = 0; i < sizeof(struct LEDMessageFormat); i++) {
-        printf("%02X ", *(ptr + i));
-      }
-      break;
-    case kCommandType_Speed:
-      speed_msg = (struct SpeedMessageFormat *)command;
-      ptr = (unsigned char *)speed_msg;
-      for (size_t i = 0; i < sizeof(struct SpeedMessageFormat); i++) {
-        printf("%02X ", *(ptr + i));
-      }
-      break;
-    default:
-      break;
-  }
-  printf("\n\x1b[0m");
-}
-
-/**
- * @brief 로그 출력
- * @param[in] msg_type 출력 메시지의 타입
- * @param[in] format 출력 메시지
- * @param[in] ...
- * */
-void PrintLog(MessageType msg_type, const char *format, ...)
-{
-  va_list arg;
-
-  if (g_mib.log_level < msg_type) {
-    return;
-  } 
-
-  printf(">> ");
-  switch (msg_type) {
-    case kMessageType_Error:
-      printf("\x1b[1;31m");
-      break;
-    case kMessageType_Pass:
-      printf("\x1b[1;32m");
-      break;
-    case kMessageType_Debug:
-      printf("\x1b[1;35m");
-      break;
-    case kMessageType_Info:
-      printf("\x1b[0m");
-      break;
-  }
-  va_start(arg, format);
-  vprintf(format, arg);
-  va_end(arg);
-  printf("\x1b[0m");
-}
-
-/**
- * @brief KOBUKI의 LED를 조작한다.
- * @param[in] device tty
- * @param[in] led_num LED 숫자
- * @param[in] color 0: all off, 1: green, 2: red
- * @retval 0: 성공
- * @retval 음수: 실패
- * */
-int KOBUKI_ControlLED(int device, int led_num, int color)
-{
-
-  switch (color) {
-    case 0: PrintLog(kMessageType_Info, "Start to write led control message - led_num: %d, color: %s\n", led_num, "None"); break;
-    case 1: PrintLog(kMessageType_Info, "Start to write led control message - led_num: %d, color: %s\n", led_num, "Green"); break;
-    case 2: PrintLog(kMessageType_Info, "Start to write led control message - led_num: %d, color: %s\n", led_num, "Red"); break;
-  }
-
-  struct LEDMessageFormat msg;
-  msg.header_0 = HEADER_0;
-  msg.header_1 = HEADER_1;
-  msg.payload_len = PAYLOAD_LED_LEN;
-  msg.sub_payload_id = LED_CONTROL_ID;
-  msg.sub_payload_len = LED_CONTROL_LEN;
-
-  if (led_num == 1) {
-    if (color == kLEDColor_Green) {
-      g_mib.led_status = g_mib.led_status | 1 << 9;
-      msg.led = g_mib.led_status;
-    }
-    else if (color == kLEDColor_Red) {
-      g_mib.led_status = g_mib.led_status | 1 << 8;
-      msg.led = g_mib.led_status;
-    }
-    else if (color == kLEDColor_None) {
-      g_mib.led_status = g_mib.led_status & 0 << 8;
-      g_mib.led_status = g_mib.led_status & 0 << 9;
-      msg.led = g_mib.led_status;
-    }
-    else {
-      PrintLog(kMessageType_Error, "Fila to write led control message - not support the color: %d\n", color);
-      return -1;
-    }
-  }
-  else if (led_num == 2) {
-    if (color == kLEDColor_Green) {
-      g_mib.led_status = g_mib.led_status | 1 << 11;
-      msg.led = g_mib.led_status;
-    }
-    else if (color == kLEDColor_Red) {
-      g_mib.led_status = g_mib.led_status | 1 << 10;
-      msg.led = g_mib.led_status;
-    }
-    else if (color == kLEDColor_None) {
-      g_mib.led_status = g_mib.led_status & 0 << 10;
-      g_mib.led_status = g_mib.led_status & 0 << 11;
-      msg.led = g_mib.led_status;
-    }
-    else {
-      PrintLog(kMessageType_Error, "Fila to write led control message - not support the color: %d\n", color);
-      return -1;
-    }
-  }
-  else {
-    PrintLog(kMessageType_Error, "Fail to write led control message - not support the led_num: %d\n", led_num);
-    return -1;
-  }
-
-  // crc 때문에 + 1
-  int ret = SendUDPMessage(g_mib.socket, g_mib.server_addr, (char *)&msg, sizeof(struct LEDMessageFormat) + 1);
-  if (ret < 0) {
-    PrintLog(kMessageType_Error, "Fail to send led control message - ret: %d\n", ret);
-    return -1;
-  }
-  else {
-    PrintLog(kMessageType_Pass, "Success to send led control message\n");
-  }
-#if 0
-  int ret = write(device, &msg, sizeof(struct LEDMessageFormat) + 1);
-  if (ret < 0) {
-    PrintLog(kMessageType_Error, "Fail to write led control message - ret: %d\n", ret);
-    return -1;
-  }
-  else {
-    PrintLog(kMessageType_Pass, "Success to write led control message\n");
-  }
-#endif
-
-  PrintHexDump(kMessageType_Debug, kCommandType_LED, "led_msg", &msg);
-  return 0;
-}
-
-
-/**
- * @brief KOBUKI의 speed를 조작한다.
- * @param[in] device tty
- * @param[in] speed 속도 mm/s 단위
- * @param[in] radius mm 단위
- * @retval 0: 성공
- * @retval 음수: 실패
- * */
-int KOBUKI_ControlSpeed(int device, int speed, int radius)
-{
-  PrintLog(kMessageType_Info, "Start to write speed control message - speed: %d, radius: %d\n", speed, radius);
-
-  struct SpeedMessageFormat msg;
-  msg.header_0 = HEADER_0;
-  msg.header_1 = HEADER_1;
-  msg.payload_len = PAYLOAD_SPEED_LEN;
-  msg.sub_payload_id = BASE_CONTROL_ID;
-  msg.sub_payload_len = BASE_CONTROL_LEN;
-  msg.speed = speed;
-  msg.radius = radius;
-  
-  // crc 때문에 + 1
-  int ret = SendUDPMessage(g_mib.socket, g_mib.server_addr, (char *)&msg, sizeof(struct SpeedMessageFormat) + 1);
-  if (ret < 0) {
-    PrintLog(kMessageType_Error, "Fail to send speed control message - ret: %d\n", ret);
-    return -1;
-  }
-  else {
-    PrintLog(kMessageType_Pass, "Success to send speed control message\n");
-  }
-#if 0
-  int ret = write(device, &msg, sizeof(struct SpeedMessageFormat) + 1);
-  if (ret < 0) {
-    PrintLog(kMessageType_Error, "Fail to write speed control message - ret: %d\n", ret);
-    return -1;
-  }
-  else {
-    PrintLog(kMessageType_Pass, "Success to write speed control message\n");
-  }
-#endif
-  PrintHexDump(kMessageType_Debug, kCommandType_Speed, "speed", &msg);
-
-  return 0;
-}
-
-/**
- * @brief 스크립트 파일을 읽어서 저장한다.
- * @param[in] script_file 스크립트 파일 이름(경로)
- * @param[out] command_buf 저장할 커맨드 버퍼
- * @retval 0: 성공
- * @retval -1: 실패
- * */
-int ParseScriptCommand(char *script_file, struct MIB *mib)
-{
-  PrintLog(kMessageType_Info, "Start to parse script file\n");
-  char buf[1000];
-  int line = 0;
-  int file_line = 0;
-
-  g_mib.script_lines_size = 0;
-
-  FILE *fp = fopen(script_file, "r");
-  if (fp == NULL) {
-    PrintLog(kMessageType_Error, "Fail to open script file\n");
-    return -1;
-  }
-
-  while (!feof(fp)) {
-    file_line++;
-    fgets(buf, sizeof(buf), fp);
-
-    /* 파일 끝 확인 후, 종료 */
-    if (feof(fp)) {
-      break;
-    }
-
-    /* 개행문자 삭제 */
-    if (strstr(buf, "\r") != NULL) { *strstr(buf, "\r") = '\0'; }
-    if (strstr(buf, "\n") != NULL) { *strstr(buf, "\n") = '\0'; }
-    
-    /* 공백 줄 예외처리 */
-    if (buf[0] == '\0') {
-      continue;
-    }
-
-    /* 초기화 */
-    g_mib.script_lines[line].type = kCommandType_None;
-
-    /* 문자열 분리 */
-    char *ptr = strtok(buf, " ");
-
-    /* 주석 문자열 예외처리 */
-    if (strcmp(ptr, "#") == 0) {
-      continue;
-    }
-    if (ptr == NULL) {
-      continue;
-    }
-    
-    /* 속도(이동) 처리 */
-    if (strcmp(buf, "speed") == 0) {
-      mib->script_lines[line].type = kCommandType_Speed;
-
-      /**
-       * speed
-       * input: km/s 단위
-       * output: mm/s 단위 
-       */
-      ptr = strtok(NULL, " ");
-      if (ptr == NULL) {
-        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
-        fclose(fp);
-        return -1;
-      }
-      mib->script_lines[line].speed = (int)((atof(ptr) * 1000000) / 3600);
-
-      /**
-       * radius
-       * input: m 단위
-       * output: mm 단위
-       */
-      ptr = strtok(NULL, " ");
-      if (ptr == NULL) {
-        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
-        fclose(fp);
-        return -1;
-      }
-      mib->script_lines[line].radius = (int)(atof(ptr));
-      if (mib->script_lines[line].radius > 1) {
-        mib->script_lines[line].radius += 115;
-      }
-      else if (mib->script_lines[line].radius < -1) {
-        mib->script_lines[line].radius -= 115;
-      }
-
-      /**
-       * radian
-       * input: degree 단위
-       * output: radian 단위
-       */
-      ptr = strtok(NULL, " ");
-      if (ptr == NULL) {
-        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
-        fclose(fp);
-        return -1;
-      }
-      if (mib->script_lines[line].radius <= 1 && mib->script_lines[line].radius >= -1) {
-        mib->script_lines[line].radian = atof(ptr) * M_PI;
-      }
-      else {
-        mib->script_lines[line].radian = (atof(ptr) * M_PI) / 90;
-      }
-      
-      // mib->script_lines[line].radian = atoi(ptr);
-
-      /**
-       * distance
-       * input: m 단위
-       * output: mm 단위
-       */
-      ptr = strtok(NULL, " ");
-      if (ptr == NULL) {
-        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
-        fclose(fp);
-        return -1;
-      }
-      mib->script_lines[line].distance = (int)(atof(ptr) * 1000);
-
-      // move_time 이동 시간 ms 단위
-      float move_time;
-      if (mib->script_lines[line].radius >= 1 || mib->script_lines[line].radius <= -1) {
-        move_time = (float)((mib->script_lines[line].radius) * mib->script_lines[line].radian) / (float)mib->script_lines[line].speed;
-      }
-      else if (mib->script_lines[line].radius == 0) {
-        move_time = ((float)mib->script_lines[line].distance / (float)mib->script_lines[line].speed);
-      }
-
-      if (mib->script_lines[line].speed == 0) {
-        move_time = 0;
-      }
-
-      if (move_time < 0) {
-        move_time *= -1;
-      }
-      move_time = (int)(move_time * 1000);
-      mib->script_lines[line].move_time = move_time;
-    }
-
-    /* 딜레이 처리 */
-    else if (strcmp(buf, "sleep") == 0) {
-      mib->script_lines[line].type = kCommandType_Sleep;
-
-      /* 딜레이 시간 ms 단위 */
-      ptr = strtok(NULL, " ");
-      if (ptr == NULL) {
-        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
-        fclose(fp);
-        return -1;
-      }
-      mib->script_lines[line].delay = atoi(ptr);
-    }
-
-    /* LED 처리 */
-    else if (strcmp(buf, "led") == 0) {
-      mib->script_lines[line].type = kCommandType_LED;
-
-      /* LED 번호(0, 1) */
-      ptr = strtok(NULL, " ");
-      if (ptr == NULL) {
-        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
-        fclose(fp);
-        return -1;
-      }
-      mib->script_lines[line].led_num = atoi(ptr);
-
-      /* LED 색상(0: off, 1: green, 2: red) */
-      ptr = strtok(NULL, " ");
-      if (ptr == NULL) {
-        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
-        fclose(fp);
-        return -1;
-      }
-      mib->script_lines[line].color = atoi(ptr);
-    }
-    else {
-      continue;
-    } 
-    line++;
-  }
-  fclose(fp);
-
-  mib->script_lines_size = line;
-  PrintLog(kMessageType_Pass, "Success to parse script file - script_lines_size: %d\n", mib->script_lines_size);
-  for (int i = 0; i < mib->script_lines_size; i++) {
-    switch (mib->script_lines[i].type) {
-      case kCommandType_None: 
-        PrintLog(kMessageType_Debug, "#%d: None\n", i); 
-        break;
-      case kCommandType_Speed: 
-        PrintLog(kMessageType_Debug, "#%d: Speed - speed: %dmm/s, radius: %dmm, radian: %lf, distance: %dmm, move_time: %dms\n", 
-                i, mib->script_lines[i].speed, mib->script_lines[i].radius, mib->script_lines[i].radian, mib->script_lines[i].distance, mib->script_lines[i].move_time); 
-        break;
-      case kCommandType_Sleep: 
-        PrintLog(kMessageType_Debug, "#%d: Sleep - time: %dms\n", i, mib->script_lines[i].delay); 
-        break;
-      case kCommandType_LED: 
-        PrintLog(kMessageType_Debug, "#%d: LED - led_num: %d, led_color: %d\n", 
-                i, mib->script_lines[i].led_num, mib->script_lines[i].color); 
-        break;
-    }
-  }
-  return 0;
-}
\ No newline at end of file
+// C library headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+#include <math.h>
+
+// Linux headers
+#include <fcntl.h> // Contains file controls like O_RDWR
+#include <termios.h> // Contains POSIX terminal control definitions
+#include <unistd.h> // write(), read(), close()
+
+// User headers
+#include "kobuki.h"
+
+struct MIB g_mib;
+
+#define _USE_MATH_DEFINES
+
+/**
+ * @brief hex dump 출력
+ * @param[in] msg_type 출력 메시지의 타입
+ * @param[in] command_type 커맨드의 타입
+ * @param[in] format 출력 메시지 prefix
+ * @param[in] command 커맨드의 구조체 포인터
+ * */
+void PrintHexDump(MessageType msg_type, CommandType command_type, const char *format, void *command)
+{
+  struct LEDMessageFormat *led_msg;
+  struct SpeedMessageFormat *speed_msg;
+
+  if (g_mib.log_level < msg_type) {
+    return;
+  }
+
+  printf(">> ");
+  switch (msg_type) {
+    case kMessageType_Error:
+      printf("\x1b[1;31m");
+      break;
+    case kMessageType_Pass:
+      printf("\x1b[1;32m");
+      break;
+    case kMessageType_Debug:
+      printf("\x1b[1;35m");
+      break;
+    case kMessageType_Info:
+      printf("\x1b[0m");
+      break;
+  }
+
+  unsigned char *ptr;
+  printf("%s: ", format);
+  switch (command_type) {
+    case kCommandType_LED:
+      led_msg = (struct LEDMessageFormat *)command;
+      ptr = (unsigned char *)led_msg;
+      for (size_t i = 0; i < sizeof(struct LEDMessageFormat); i++) {
+        printf("%02X ", *(ptr + i));
+      }
+      break;
+    case kCommandType_Speed:
+      speed_msg = (struct SpeedMessageFormat *)command;
+      ptr = (unsigned char *)speed_msg;
+      for (size_t i = 0; i < sizeof(struct SpeedMessageFormat); i++) {
+        printf("%02X ", *(ptr + i));
+      }
+      break;
+    default:
+      break;
+  }
+  printf("\n\x1b[0m");
+}
+
+/**
+ * @brief 로그 출력
+ * @param[in] msg_type 출력 메시지의 타입
+ * @param[in] format 출력 메시지
+ * @param[in] ...
+ * */
+void PrintLog(MessageType msg_type, const char *format, ...)
+{
+  va_list arg;
+
+  if (g_mib.log_level < msg_type) {
+    return;
+  } 
+
+  TRACE_BEGIN(trace_span);
+  printf(">> ");
+  switch (msg_type) {
+    case kMessageType_Error:
+      printf("\x1b[1;31m");
+      break;
+    case kMessageType_Pass:
+      printf("\x1b[1;32m");
+      break;
+    case kMessageType_Debug:
+      printf("\x1b[1;35m");
+      break;
+    case kMessageType_Info:
+      printf("\x1b[0m");
+      break;
+  }
+  va_start(arg, format);
+  vprintf(format, arg);
+  va_end(arg);
+  printf("\x1b[0m");
+  TRACE_END(trace_span, "PrintLog");
+}
+
+/**
+ * @brief KOBUKI 패킷의 checksum 을 계산한다.
+ * @param[in] packet KOBUKI 패킷 (header 포함, crc 제외)
+ * @param[in] packet_len KOBUKI 패킷 길이
+ * @return header 를 제외한 모든 byte 의 XOR
+ * */
+uint8_t KOBUKI_Checksum(const uint8_t *packet, size_t packet_len)
+{
+  uint8_t crc = 0;
+
+  for (size_t i = 2; i < packet_len; i++) {
+    crc ^= packet[i];
+  }
+  return crc;
+}
+
+/**
+ * @brief KOBUKI의 LED를 조작한다.
+ * @param[in] device tty
+ * @param[in] led_num LED 숫자
+ * @param[in] color 0: all off, 1: green, 2: red
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ * */
+int KOBUKI_ControlLED(int device, int led_num, int color)
+{
+  TRACE_BEGIN(trace_span);
+
+  switch (color) {
+    case 0: PrintLog(kMessageType_Info, "Start to write led control message - led_num: %d, color: %s\n", led_num, "None"); break;
+    case 1: PrintLog(kMessageType_Info, "Start to write led control message - led_num: %d, color: %s\n", led_num, "Green"); break;
+    case 2: PrintLog(kMessageType_Info, "Start to write led control message - led_num: %d, color: %s\n", led_num, "Red"); break;
+  }
+
+  struct LEDMessageFormat msg;
+  msg.header_0 = HEADER_0;
+  msg.header_1 = HEADER_1;
+  msg.payload_len = PAYLOAD_LED_LEN;
+  msg.sub_payload_id = LED_CONTROL_ID;
+  msg.sub_payload_len = LED_CONTROL_LEN;
+
+  if (led_num == 1) {
+    if (color == kLEDColor_Green) {
+      g_mib.led_status = g_mib.led_status | 1 << 9;
+      msg.led = g_mib.led_status;
+    }
+    else if (color == kLEDColor_Red) {
+      g_mib.led_status = g_mib.led_status | 1 << 8;
+      msg.led = g_mib.led_status;
+    }
+    else if (color == kLEDColor_None) {
+      g_mib.led_status = g_mib.led_status & 0 << 8;
+      g_mib.led_status = g_mib.led_status & 0 << 9;
+      msg.led = g_mib.led_status;
+    }
+    else {
+      PrintLog(kMessageType_Error, "Fila to write led control message - not support the color: %d\n", color);
+      TRACE_END(trace_span, "KOBUKI_ControlLED");
+      return -1;
+    }
+  }
+  else if (led_num == 2) {
+    if (color == kLEDColor_Green) {
+      g_mib.led_status = g_mib.led_status | 1 << 11;
+      msg.led = g_mib.led_status;
+    }
+    else if (color == kLEDColor_Red) {
+      g_mib.led_status = g_mib.led_status | 1 << 10;
+      msg.led = g_mib.led_status;
+    }
+    else if (color == kLEDColor_None) {
+      g_mib.led_status = g_mib.led_status & 0 << 10;
+      g_mib.led_status = g_mib.led_status & 0 << 11;
+      msg.led = g_mib.led_status;
+    }
+    else {
+      PrintLog(kMessageType_Error, "Fila to write led control message - not support the color: %d\n", color);
+      TRACE_END(trace_span, "KOBUKI_ControlLED");
+      return -1;
+    }
+  }
+  else {
+    PrintLog(kMessageType_Error, "Fail to write led control message - not support the led_num: %d\n", led_num);
+    TRACE_END(trace_span, "KOBUKI_ControlLED");
+    return -1;
+  }
+
+  // crc 때문에 + 1
+  uint8_t frame[sizeof(struct LEDMessageFormat) + 1];
+  memcpy(frame, &msg, sizeof(struct LEDMessageFormat));
+  frame[sizeof(struct LEDMessageFormat)] = KOBUKI_Checksum(frame, sizeof(struct LEDMessageFormat));
+  int ret = SendReliableState(LED_CONTROL_ID, frame, sizeof(frame));
+  if (ret < 0) {
+    PrintLog(kMessageType_Error, "Fail to send led control message - ret: %d\n", ret);
+    TRACE_END(trace_span, "KOBUKI_ControlLED");
+    return -1;
+  }
+  else {
+    PrintLog(kMessageType_Pass, "Success to send led control message\n");
+  }
+#if 0
+  int ret = write(device, &msg, sizeof(struct LEDMessageFormat) + 1);
+  if (ret < 0) {
+    PrintLog(kMessageType_Error, "Fail to write led control message - ret: %d\n", ret);
+    return -1;
+  }
+  else {
+    PrintLog(kMessageType_Pass, "Success to write led control message\n");
+  }
+#endif
+
+  PrintHexDump(kMessageType_Debug, kCommandType_LED, "led_msg", &msg);
+  TRACE_END(trace_span, "KOBUKI_ControlLED");
+  return 0;
+}
+
+
+/**
+ * @brief KOBUKI speed 패킷을 만든다.
+ * @param[out] frame SPEED_FRAME_LEN 크기 이상의 버퍼
+ * @param[in] speed 속도 mm/s 단위
+ * @param[in] radius mm 단위
+ * @return 패킷 길이 (crc 포함)
+ * */
+size_t KOBUKI_EncodeSpeed(uint8_t *frame, int speed, int radius)
+{
+  struct SpeedMessageFormat msg;
+  msg.header_0 = HEADER_0;
+  msg.header_1 = HEADER_1;
+  msg.payload_len = PAYLOAD_SPEED_LEN;
+  msg.sub_payload_id = BASE_CONTROL_ID;
+  msg.sub_payload_len = BASE_CONTROL_LEN;
+  msg.speed = speed;
+  msg.radius = radius;
+
+  // crc 때문에 + 1
+  memcpy(frame, &msg, sizeof(struct SpeedMessageFormat));
+  frame[sizeof(struct SpeedMessageFormat)] = KOBUKI_Checksum(frame, sizeof(struct SpeedMessageFormat));
+  return SPEED_FRAME_LEN;
+}
+
+/**
+ * @brief 미리 만들어 둔 stop 패킷을 즉시 실행되도록 전송한다.
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ * @details 종료 시그널 처리 경로에서 호출되므로 전송 전에는 로그를 출력하지 않는다.
+ * */
+int KOBUKI_EmergencyStop(void)
+{
+  int ret = SendReliableStateAt(BASE_CONTROL_ID, g_mib.stop_frame, SPEED_FRAME_LEN, 0);
+  g_mib.link.request_speed = 0;
+  g_mib.link.applied_speed = 0;
+  return ret;
+}
+
+/**
+ * @brief KOBUKI의 speed를 조작한다.
+ * @param[in] device tty
+ * @param[in] speed 속도 mm/s 단위
+ * @param[in] radius mm 단위
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ * */
+int KOBUKI_ControlSpeed(int device, int speed, int radius)
+{
+  (void)device;
+  TRACE_BEGIN(trace_span);
+  PrintLog(kMessageType_Info, "Start to write speed control message - speed: %d, radius: %d\n", speed, radius);
+  /* link 상태가 나빠지면 ChangeLinkState() 가 이 요청을 새 최대 속도로 다시 전송한다. */
+  g_mib.link.request_speed = speed;
+  g_mib.link.request_radius = radius;
+  g_mib.link.request_time_us = g_mib.command_time_us;
+  speed = LimitLinkSpeed(speed);
+  g_mib.link.applied_speed = speed;
+
+  uint8_t frame[SPEED_FRAME_LEN];
+  size_t frame_len = KOBUKI_EncodeSpeed(frame, speed, radius);
+  int ret = SendReliableState(BASE_CONTROL_ID, frame, frame_len);
+  if (ret < 0) {
+    PrintLog(kMessageType_Error, "Fail to send speed control message - ret: %d\n", ret);
+    TRACE_END(trace_span, "KOBUKI_ControlSpeed");
+    return -1;
+  }
+  else {
+    PrintLog(kMessageType_Pass, "Success to send speed control message\n");
+  }
+#if 0
+  int ret = write(device, &msg, sizeof(struct SpeedMessageFormat) + 1);
+  if (ret < 0) {
+    PrintLog(kMessageType_Error, "Fail to write speed control message - ret: %d\n", ret);
+    return -1;
+  }
+  else {
+    PrintLog(kMessageType_Pass, "Success to write speed control message\n");
+  }
+#endif
+  PrintHexDump(kMessageType_Debug, kCommandType_Speed, "speed", frame);
+  TRACE_END(trace_span, "KOBUKI_ControlSpeed");
+  return 0;
+}
+
+/**
+ * @brief KOBUKI에 추가 정보(버전 등)를 요청한다.
+ * @param[in] device tty
+ * @param[in] request_flags REQUEST_EXTRA_* 조합
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ * */
+int KOBUKI_RequestExtra(int device, uint16_t request_flags)
+{
+  (void)device;
+  PrintLog(kMessageType_Info, "Start to write request extra message - request_flags: 0x%04X\n", request_flags);
+
+  struct RequestExtraMessageFormat msg;
+  msg.header_0 = HEADER_0;
+  msg.header_1 = HEADER_1;
+  msg.payload_len = REQUEST_EXTRA_LEN + 2;
+  msg.sub_payload_id = REQUEST_EXTRA_ID;
+  msg.sub_payload_len = REQUEST_EXTRA_LEN;
+  msg.request_flags = request_flags;
+
+  // crc 때문에 + 1
+  uint8_t frame[sizeof(struct RequestExtraMessageFormat) + 1];
+  memcpy(frame, &msg, sizeof(struct RequestExtraMessageFormat));
+  frame[sizeof(struct RequestExtraMessageFormat)] = KOBUKI_Checksum(frame, sizeof(struct RequestExtraMessageFormat));
+  int ret = SendReliableState(REQUEST_EXTRA_ID, frame, sizeof(frame));
+  if (ret < 0) {
+    PrintLog(kMessageType_Error, "Fail to send request extra message - ret: %d\n", ret);
+    return -1;
+  }
+  PrintLog(kMessageType_Pass, "Success to send request extra message\n");
+  return 0;
+}
+
+/**
+ * @brief 스크립트 값을 int 범위로 제한한다.
+ * @param[in] value 변환할 값
+ * @param[in] min 최소값
+ * @param[in] max 최대값
+ * @param[out] clamped 값을 제한했으면 true 로 바꾼다.
+ * @return 제한된 값, NaN 은 0
+ * */
+static int ClampScriptValue(double value, int min, int max, bool *clamped)
+{
+  if (value != value) {
+    *clamped = true;
+    return 0;
+  }
+  if (value < min) {
+    *clamped = true;
+    return min;
+  }
+  if (value > max) {
+    *clamped = true;
+    return max;
+  }
+  return (int)value;
+}
+
+/**
+ * @brief 스크립트 파일을 읽어서 저장한다.
+ * @param[in] script_file 스크립트 파일 이름(경로)
+ * @param[in] profile 이동 시간 계산에 쓰는 kinematic profile
+ * @param[out] script 저장할 script 버퍼
+ * @retval 0: 성공
+ * @retval -1: 실패
+ * */
+int ParseScriptCommand(const char *script_file, const struct KinematicProfile *profile, struct Script *script)
+{
+  PrintLog(kMessageType_Info, "Start to parse script file\n");
+
+  FILE *fp = fopen(script_file, "r");
+  if (fp == NULL) {
+    PrintLog(kMessageType_Error, "Fail to open script file\n");
+    return -1;
+  }
+
+  TRACE_BEGIN(trace_span);
+  int ret = ParseScriptStream(fp, profile, script);
+  TRACE_END_ID(trace_span, "ParseScriptStream", 0);
+  fclose(fp);
+  return ret;
+}
+
+/**
+ * @brief 스크립트 스트림을 읽어서 저장한다.
+ * @param[in] fp 스크립트 스트림 (파일, fmemopen 등)
+ * @param[in] profile 이동 시간 계산에 쓰는 kinematic profile
+ * @param[out] script 저장할 script 버퍼
+ * @retval 0: 성공
+ * @retval -1: 실패
+ * */
+int ParseScriptStream(FILE *fp, const struct KinematicProfile *profile, struct Script *script)
+{
+  char buf[1000];
+  int line = 0;
+  int file_line = 0;
+
+  script->lines_size = 0;
+
+  while (fgets(buf, sizeof(buf), fp) != NULL) {
+    file_line++;
+
+    /* 최대 커맨드 개수 확인 */
+    if (line >= SCRIPT_COMMAND_MAX_LEN) {
+      PrintLog(kMessageType_Error, "Fail to load script command line - too many commands, line: %d\n", file_line);
+      return -1;
+    }
+
+    /* 개행문자 삭제 */
+    if (strstr(buf, "\r") != NULL) { *strstr(buf, "\r") = '\0'; }
+    if (strstr(buf, "\n") != NULL) { *strstr(buf, "\n") = '\0'; }
+    
+    /* 공백 줄 예외처리 */
+    if (buf[0] == '\0') {
+      continue;
+    }
+
+    /* 초기화 */
+    script->lines[line].type = kCommandType_None;
+    script->lines[line].clamped = false;
+
+    /* 문자열 분리 (reload 는 watch thread 에서 읽으므로 strtok_r 을 쓴다.) */
+    char *save_ptr = NULL;
+    char *ptr = strtok_r(buf, " ", &save_ptr);
+    if (ptr == NULL) {
+      continue;
+    }
+
+    /* 주석 문자열 예외처리 */
+    if (strcmp(ptr, "#") == 0) {
+      continue;
+    }
+    
+    /* 속도(이동) 처리 */
+    if (strcmp(buf, "speed") == 0) {
+      script->lines[line].type = kCommandType_Speed;
+
+      /**
+       * speed
+       * input: km/s 단위
+       * output: mm/s 단위 
+       */
+      ptr = strtok_r(NULL, " ", &save_ptr);
+      if (ptr == NULL) {
+        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
+        return -1;
+      }
+      script->lines[line].speed = ClampScriptValue((atof(ptr) * 1000000) / 3600, INT16_MIN, INT16_MAX, &script->lines[line].clamped);
+
+      /**
+       * radius
+       * input: m 단위
+       * output: mm 단위
+       */
+      ptr = strtok_r(NULL, " ", &save_ptr);
+      if (ptr == NULL) {
+        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
+        return -1;
+      }
+      script->lines[line].radius = ClampScriptValue(atof(ptr), INT16_MIN, INT16_MAX, &script->lines[line].clamped);
+      int radius_offset = (int)(profile->wheel_base_mm / 2 + 0.5f);
+      if (script->lines[line].radius > 1) {
+        script->lines[line].radius = ClampScriptValue(script->lines[line].radius + radius_offset, INT16_MIN, INT16_MAX, &script->lines[line].clamped);
+      }
+      else if (script->lines[line].radius < -1) {
+        script->lines[line].radius = ClampScriptValue(script->lines[line].radius - radius_offset, INT16_MIN, INT16_MAX, &script->lines[line].clamped);
+      }
+
+      /**
+       * radian
+       * input: degree 단위
+       * output: radian 단위
+       */
+      ptr = strtok_r(NULL, " ", &save_ptr);
+      if (ptr == NULL) {
+        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
+        return -1;
+      }
+      script->lines[line].radian = (atof(ptr) * M_PI) / 180;
+      
+      // script->lines[line].radian = atoi(ptr);
+
+      /**
+       * distance
+       * input: m 단위
+       * output: mm 단위
+       */
+      ptr = strtok_r(NULL, " ", &save_ptr);
+      if (ptr == NULL) {
+        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
+        return -1;
+      }
+      script->lines[line].distance = ClampScriptValue(atof(ptr) * 1000, -SCRIPT_VALUE_MAX, SCRIPT_VALUE_MAX, &script->lines[line].clamped);
+
+      // move_time 이동 시간 ms 단위, profile 로 보정한다.
+      double move_time = 0;
+      if (script->lines[line].radius == 1 || script->lines[line].radius == -1) {
+        move_time = script->lines[line].radian * profile->spin_radius_mm / script->lines[line].speed;
+      }
+      else if (script->lines[line].radius != 0) {
+        move_time = (script->lines[line].radius * script->lines[line].radian * profile->arc_gain) / script->lines[line].speed;
+      }
+      else if (profile->speed_gain > 0) {
+        move_time = script->lines[line].distance / (script->lines[line].speed * profile->speed_gain);
+        move_time += (move_time < 0 ? -1 : 1) * profile->time_offset_ms / 1000.0;
+      }
+
+      if (script->lines[line].speed == 0) {
+        move_time = 0;
+      }
+
+      if (move_time < 0) {
+        move_time *= -1;
+      }
+      script->lines[line].move_time = ClampScriptValue(move_time * 1000, 0, SCRIPT_VALUE_MAX, &script->lines[line].clamped);
+    }
+
+    /* waypoint 처리: waypoint <x m> <y m> [km/h] */
+    else if (strcmp(buf, "waypoint") == 0) {
+      script->lines[line].type = kCommandType_Waypoint;
+
+      ptr = strtok_r(NULL, " ", &save_ptr);
+      if (ptr == NULL) {
+        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
+        return -1;
+      }
+      script->lines[line].x = ClampScriptValue(atof(ptr) * 1000, -SCRIPT_VALUE_MAX, SCRIPT_VALUE_MAX, &script->lines[line].clamped);
+
+      ptr = strtok_r(NULL, " ", &save_ptr);
+      if (ptr == NULL) {
+        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
+        return -1;
+      }
+      script->lines[line].y = ClampScriptValue(atof(ptr) * 1000, -SCRIPT_VALUE_MAX, SCRIPT_VALUE_MAX, &script->lines[line].clamped);
+
+      /* 속도는 생략할 수 있다. */
+      script->lines[line].speed = WAYPOINT_SPEED_DEFAULT;
+      ptr = strtok_r(NULL, " ", &save_ptr);
+      if (ptr != NULL) {
+        int speed = abs(ClampScriptValue((atof(ptr) * 1000000) / 3600, -INT16_MAX, INT16_MAX, &script->lines[line].clamped));
+        script->lines[line].speed = (speed != 0) ? speed : WAYPOINT_SPEED_DEFAULT;
+      }
+    }
+
+    /* 딜레이 처리 */
+    else if (strcmp(buf, "sleep") == 0) {
+      script->lines[line].type = kCommandType_Sleep;
+
+      /* 딜레이 시간 ms 단위 */
+      ptr = strtok_r(NULL, " ", &save_ptr);
+      if (ptr == NULL) {
+        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
+        return -1;
+      }
+      script->lines[line].delay = ClampScriptValue(atof(ptr), 0, SCRIPT_VALUE_MAX, &script->lines[line].clamped);
+    }
+
+    /* LED 처리 */
+    else if (strcmp(buf, "led") == 0) {
+      script->lines[line].type = kCommandType_LED;
+
+      /* LED 번호(0, 1) */
+      ptr = strtok_r(NULL, " ", &save_ptr);
+      if (ptr == NULL) {
+        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
+        return -1;
+      }
+      script->lines[line].led_num = atoi(ptr);
+
+      /* LED 색상(0: off, 1: green, 2: red) */
+      ptr = strtok_r(NULL, " ", &save_ptr);
+      if (ptr == NULL) {
+        PrintLog(kMessageType_Error, "Fail to load script command line - line: %d\n", file_line);
+        return -1;
+      }
+      script->lines[line].color = atoi(ptr);
+    }
+    else {
+      continue;
+    } 
+    line++;
+  }
+
+  script->lines_size = line;
+  PrintLog(kMessageType_Pass, "Success to parse script file - lines_size: %d\n", script->lines_size);
+  for (int i = 0; i < script->lines_size; i++) {
+    switch (script->lines[i].type) {
+      case kCommandType_None: 
+        PrintLog(kMessageType_Debug, "#%d: None\n", i); 
+        break;
+      case kCommandType_Speed: 
+        PrintLog(kMessageType_Debug, "#%d: Speed - speed: %dmm/s, radius: %dmm, radian: %lf, distance: %dmm, move_time: %dms\n", 
+                i, script->lines[i].speed, script->lines[i].radius, script->lines[i].radian, script->lines[i].distance, script->lines[i].move_time); 
+        break;
+      case kCommandType_Waypoint:
+        PrintLog(kMessageType_Debug, "#%d: Waypoint - x: %dmm, y: %dmm, speed: %dmm/s\n",
+                i, script->lines[i].x, script->lines[i].y, script->lines[i].speed);
+        break;
+      case kCommandType_Sleep: 
+        PrintLog(kMessageType_Debug, "#%d: Sleep - time: %dms\n", i, script->lines[i].delay); 
+        break;
+      case kCommandType_LED: 
+        PrintLog(kMessageType_Debug, "#%d: LED - led_num: %d, led_color: %d\n", 
+                i, script->lines[i].led_num, script->lines[i].color); 
+        break;
+    }
+  }
+  return 0;
+}
+/**
+ * @brief "<key> <value>" 설정 파일을 읽는다. (link policy, kinematic profile)
+ * @param[in] config_file 설정 파일 이름
+ * @param[in] keys 허용하는 항목
+ * @param[in] keys_size 항목 개수
+ * @param[in,out] config 설정 구조체, 파일에 있는 항목만 바뀐다.
+ * @retval 0: 성공
+ * @retval -1: 실패
+ * @details '#' 으로 시작하는 줄은 주석
+ * */
+int LoadConfigFile(const char *config_file, const struct ConfigKey *keys, size_t keys_size, void *config)
+{
+  FILE *fp = fopen(config_file, "r");
+  if (fp == NULL) {
+    PrintLog(kMessageType_Error, "Fail to open config file - %s\n", config_file);
+    return -1;
+  }
+
+  char buf[CONFIG_LINE_MAX_LEN];
+  int file_line = 0;
+  int ret = 0;
+  while (fgets(buf, sizeof(buf), fp) != NULL) {
+    file_line++;
+
+    char name[CONFIG_LINE_MAX_LEN];
+    char value[CONFIG_LINE_MAX_LEN];
+    int fields = sscanf(buf, "%127s %127s", name, value);
+    if (fields <= 0 || name[0] == '#') {
+      continue;
+    }
+
+    const struct ConfigKey *key = NULL;
+    for (size_t i = 0; i < keys_size; i++) {
+      if (strcmp(name, keys[i].name) == 0) {
+        key = &keys[i];
+        break;
+      }
+    }
+    if (key == NULL || fields < 2) {
+      PrintLog(kMessageType_Error, "Fail to load config file - %s, line: %d, %s\n", config_file, file_line, name);
+      ret = -1;
+      break;
+    }
+
+    char *end = NULL;
+    if (key->is_float) {
+      *(float *)((uint8_t *)config + key->offset) = strtof(value, &end);
+    }
+    else {
+      *(int *)((uint8_t *)config + key->offset) = (int)strtol(value, &end, 10);
+    }
+    if (end == value || *end != '\0') {
+      PrintLog(kMessageType_Error, "Fail to load config file - %s, line: %d, %s: %s\n", config_file, file_line, name, value);
+      ret = -1;
+      break;
+    }
+  }
+  fclose(fp);
+  return ret;
+}
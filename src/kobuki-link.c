@@ -0,0 +1,282 @@
+#include <stddef.h>
+
+#include "kobuki.h"
+
+static const char *g_link_state_names[kLinkState_Max] = { "good", "degraded", "poor", "lost" };
+
+/**
+ * @brief --link-policy 파일의 항목
+ */
+static const struct ConfigKey g_link_policy_keys[] = {
+  { "degraded_loss", offsetof(struct LinkPolicy, degraded_loss), true },
+  { "poor_loss", offsetof(struct LinkPolicy, poor_loss), true },
+  { "degraded_rtt_ms", offsetof(struct LinkPolicy, degraded_rtt_ms), false },
+  { "poor_rtt_ms", offsetof(struct LinkPolicy, poor_rtt_ms), false },
+  { "lost_timeout_ms", offsetof(struct LinkPolicy, lost_timeout_ms), false },
+  { "recover_ms", offsetof(struct LinkPolicy, recover_ms), false },
+  { "copies_good", offsetof(struct LinkPolicy, copies[kLinkState_Good]), false },
+  { "copies_degraded", offsetof(struct LinkPolicy, copies[kLinkState_Degraded]), false },
+  { "copies_poor", offsetof(struct LinkPolicy, copies[kLinkState_Poor]), false },
+  { "copies_lost", offsetof(struct LinkPolicy, copies[kLinkState_Lost]), false },
+  { "keepalive_ms_good", offsetof(struct LinkPolicy, keepalive_ms[kLinkState_Good]), false },
+  { "keepalive_ms_degraded", offsetof(struct LinkPolicy, keepalive_ms[kLinkState_Degraded]), false },
+  { "keepalive_ms_poor", offsetof(struct LinkPolicy, keepalive_ms[kLinkState_Poor]), false },
+  { "keepalive_ms_lost", offsetof(struct LinkPolicy, keepalive_ms[kLinkState_Lost]), false },
+  { "speed_max_good", offsetof(struct LinkPolicy, speed_max[kLinkState_Good]), false },
+  { "speed_max_degraded", offsetof(struct LinkPolicy, speed_max[kLinkState_Degraded]), false },
+  { "speed_max_poor", offsetof(struct LinkPolicy, speed_max[kLinkState_Poor]), false },
+};
+
+/**
+ * @brief Initialize link quality control with the default policy
+ * @param[out] link link 상태
+ */
+void InitLink(struct LinkStatus *link)
+{
+  memset(link, 0x00, sizeof(struct LinkStatus));
+
+  struct LinkPolicy *policy = &link->policy;
+  policy->degraded_loss = LINK_DEGRADED_LOSS_DEFAULT;
+  policy->poor_loss = LINK_POOR_LOSS_DEFAULT;
+  policy->degraded_rtt_ms = LINK_DEGRADED_RTT_DEFAULT_MS;
+  policy->poor_rtt_ms = LINK_POOR_RTT_DEFAULT_MS;
+  policy->lost_timeout_ms = LINK_LOST_TIMEOUT_DEFAULT_MS;
+  policy->recover_ms = LINK_RECOVER_DEFAULT_MS;
+
+  policy->copies[kLinkState_Good] = 1;
+  policy->copies[kLinkState_Degraded] = 2;
+  policy->copies[kLinkState_Poor] = 3;
+  policy->copies[kLinkState_Lost] = 3;
+
+  policy->keepalive_ms[kLinkState_Good] = 500;
+  policy->keepalive_ms[kLinkState_Degraded] = 200;
+  policy->keepalive_ms[kLinkState_Poor] = 100;
+  policy->keepalive_ms[kLinkState_Lost] = 100;
+
+  policy->speed_max[kLinkState_Good] = 0;
+  policy->speed_max[kLinkState_Degraded] = 300;
+  policy->speed_max[kLinkState_Poor] = 150;
+
+  link->state = kLinkState_Good;
+  link->state_since_us = GetTimeUs();
+}
+
+/**
+ * @brief link policy 파일을 읽는다.
+ * @param[in] policy_file policy 파일 이름
+ * @param[in,out] policy 파일에 있는 항목만 바뀐다.
+ * @retval 0: 성공
+ * @retval -1: 실패
+ * @details 파일 구조: 한 줄에 "<항목> <값>", '#' 으로 시작하는 줄은 주석
+ */
+int LoadLinkPolicy(const char *policy_file, struct LinkPolicy *policy)
+{
+  if (LoadConfigFile(policy_file, g_link_policy_keys, sizeof(g_link_policy_keys) / sizeof(g_link_policy_keys[0]), policy) < 0) {
+    PrintLog(kMessageType_Error, "Fail to load link policy - %s\n", policy_file);
+    return -1;
+  }
+  PrintLog(kMessageType_Pass, "Success to load link policy - %s\n", policy_file);
+  return 0;
+}
+
+/**
+ * @brief 손실률, RTT, 마지막 수신 시각으로 link 상태를 판정한다.
+ * @param[in] now_us 현재 시각
+ * @details 0 이하인 기준은 사용하지 않는다.
+ */
+static LinkState EvaluateLinkState(uint64_t now_us)
+{
+  struct LinkStatus *link = &g_mib.link;
+  struct LinkPolicy *policy = &link->policy;
+  float loss_rate = g_mib.reliable.loss_rate;
+  int srtt_us = g_mib.reliable.srtt_us;
+
+  if (link->last_rx_us != 0 && policy->lost_timeout_ms > 0 &&
+      now_us >= link->last_rx_us + (uint64_t)policy->lost_timeout_ms * 1000) {
+    return kLinkState_Lost;
+  }
+  if ((policy->poor_loss > 0 && loss_rate >= policy->poor_loss) ||
+      (policy->poor_rtt_ms > 0 && srtt_us >= policy->poor_rtt_ms * 1000)) {
+    return kLinkState_Poor;
+  }
+  if ((policy->degraded_loss > 0 && loss_rate >= policy->degraded_loss) ||
+      (policy->degraded_rtt_ms > 0 && srtt_us >= policy->degraded_rtt_ms * 1000)) {
+    return kLinkState_Degraded;
+  }
+  return kLinkState_Good;
+}
+
+/**
+ * @brief 실행 중인 base control 요청을 현재 link 상태의 최대 속도로 다시 전송한다.
+ * @details 실행 시각은 처음 요청한 시각을 유지한다. 이미 지난 시각이면 bridge 는 바로 실행한다.
+ * 실행 중인 구간은 줄어든 속도로 남은 시간만큼만 움직이므로 계획보다 짧게 끝난다.
+ */
+static void ReapplyLinkSpeed(void)
+{
+  struct LinkStatus *link = &g_mib.link;
+
+  if (link->request_speed == 0) {
+    return;
+  }
+  int speed = LimitLinkSpeed(link->request_speed);
+  if (speed == link->applied_speed) {
+    return;
+  }
+
+  uint8_t frame[SPEED_FRAME_LEN];
+  size_t frame_len = KOBUKI_EncodeSpeed(frame, speed, link->request_radius);
+  if (SendReliableStateAt(BASE_CONTROL_ID, frame, frame_len, link->request_time_us) < 0) {
+    PrintLog(kMessageType_Error, "Fail to limit running speed by link state - speed: %d -> %d\n", link->applied_speed, speed);
+    return;
+  }
+  PrintLog(kMessageType_Info, "Limit running speed by link state - state: %s, speed: %d -> %d, the running segment ends short\n",
+          g_link_state_names[link->state], link->applied_speed, speed);
+  link->applied_speed = speed;
+}
+
+/**
+ * @brief link 상태를 바꾼다. Lost 가 되면 stop 을 전송하고, 나빠지면 실행 중인 속도를 새 최대 속도로 제한한다.
+ * @param[in] state 새 상태
+ * @param[in] now_us 현재 시각
+ */
+static void ChangeLinkState(LinkState state, uint64_t now_us)
+{
+  struct LinkStatus *link = &g_mib.link;
+  LinkState prev_state = link->state;
+
+  link->state_time_us[prev_state] += now_us - link->state_since_us;
+  link->state = state;
+  link->state_since_us = now_us;
+  link->better_since_us = 0;
+  link->transition_count++;
+
+  if (state == kLinkState_Lost) {
+    link->lost_count++;
+    KOBUKI_EmergencyStop();
+    PrintLog(kMessageType_Error, "Link lost - no frame from bridge for %dms, stop\n",
+            (int)((now_us - link->last_rx_us) / 1000));
+    return;
+  }
+  PrintLog((state > prev_state) ? kMessageType_Error : kMessageType_Info,
+          "Link %s -> %s - loss_rate: %.1f%%, srtt: %dus, copies: %d, keepalive: %dms, speed_max: %d\n",
+          g_link_state_names[prev_state], g_link_state_names[state], g_mib.reliable.loss_rate * 100.0f,
+          g_mib.reliable.srtt_us, link->policy.copies[state], link->policy.keepalive_ms[state], link->policy.speed_max[state]);
+  if (state > prev_state) {
+    ReapplyLinkSpeed();
+  }
+}
+
+/**
+ * @brief link 상태를 갱신하고, 전송이 없으면 keepalive 를 보낸다.
+ * @param[in] now_us 현재 시각
+ * @return 다음 keepalive (또는 Lost 판정)까지 남은 시간 ms 단위, 없으면 -1
+ * @details 나빠지는 변화는 바로 반영하고, 좋아지는 변화는 recover_ms 동안 유지되어야 반영한다.
+ */
+int ServiceLink(uint64_t now_us)
+{
+  struct LinkStatus *link = &g_mib.link;
+  struct LinkPolicy *policy = &link->policy;
+
+  LinkState state = EvaluateLinkState(now_us);
+  if (state > link->state) {
+    ChangeLinkState(state, now_us);
+  }
+  else if (state < link->state) {
+    if (link->better_since_us == 0) {
+      link->better_since_us = now_us;
+    }
+    if (now_us - link->better_since_us >= (uint64_t)policy->recover_ms * 1000) {
+      ChangeLinkState(state, now_us);
+    }
+  }
+  else {
+    link->better_since_us = 0;
+  }
+
+  int next_ms = -1;
+  int keepalive_ms = policy->keepalive_ms[link->state];
+  if (keepalive_ms > 0) {
+    uint64_t due_us = g_mib.reliable.last_tx_us + (uint64_t)keepalive_ms * 1000;
+    if (now_us >= due_us) {
+      SendReliableKeepalive(BASE_CONTROL_ID, now_us);
+      due_us = now_us + (uint64_t)keepalive_ms * 1000;
+    }
+    next_ms = (int)((due_us - now_us + 999) / 1000);
+  }
+  if (link->state != kLinkState_Lost && link->last_rx_us != 0 && policy->lost_timeout_ms > 0) {
+    uint64_t lost_us = link->last_rx_us + (uint64_t)policy->lost_timeout_ms * 1000;
+    int lost_ms = (lost_us > now_us) ? (int)((lost_us - now_us) / 1000) + 1 : 0;
+    if (next_ms < 0 || lost_ms < next_ms) {
+      next_ms = lost_ms;
+    }
+  }
+  if (link->better_since_us != 0) {
+    uint64_t recover_us = link->better_since_us + (uint64_t)policy->recover_ms * 1000;
+    int recover_ms = (recover_us > now_us) ? (int)((recover_us - now_us + 999) / 1000) : 0;
+    if (next_ms < 0 || recover_ms < next_ms) {
+      next_ms = recover_ms;
+    }
+  }
+  return next_ms;
+}
+
+/**
+ * @brief 현재 link 상태에서 sub-payload 를 보내는 횟수
+ * @param[in] sub_payload_id KOBUKI sub-payload id
+ * @return 1 이상, 중복 전송은 base control (속도, stop)만 한다.
+ */
+int GetLinkCopies(uint8_t sub_payload_id)
+{
+  int copies = g_mib.link.policy.copies[g_mib.link.state];
+
+  if (sub_payload_id != BASE_CONTROL_ID || copies < 1) {
+    return 1;
+  }
+  return copies;
+}
+
+/**
+ * @brief 현재 link 상태의 최대 속도로 제한한다.
+ * @param[in] speed 요청한 속도 mm/s 단위
+ * @return 제한한 속도, Lost 상태면 0
+ */
+int LimitLinkSpeed(int speed)
+{
+  struct LinkStatus *link = &g_mib.link;
+  int speed_max = link->policy.speed_max[link->state];
+
+  if (link->state != kLinkState_Lost && (speed_max <= 0 || abs(speed) <= speed_max)) {
+    return speed;
+  }
+  if (link->state == kLinkState_Lost) {
+    speed_max = 0;
+  }
+  if (speed == 0) {
+    return 0;
+  }
+
+  link->clamp_count++;
+  int limited = (speed > 0) ? speed_max : -speed_max;
+  PrintLog(kMessageType_Info, "Limit speed by link state - state: %s, speed: %d -> %d\n",
+          g_link_state_names[link->state], speed, limited);
+  return limited;
+}
+
+/**
+ * @brief link 통계 출력
+ */
+void PrintLinkStatus(void)
+{
+  struct LinkStatus *link = &g_mib.link;
+  uint64_t state_time_us[kLinkState_Max];
+
+  memcpy(state_time_us, link->state_time_us, sizeof(state_time_us));
+  state_time_us[link->state] += GetTimeUs() - link->state_since_us;
+
+  PrintLog(kMessageType_Info, "Link status - state: %s, transition: %u, lost: %u, duplicate: %u, keepalive: %u, clamp: %u\n",
+          g_link_state_names[link->state], link->transition_count, link->lost_count,
+          link->duplicate_count, link->keepalive_count, link->clamp_count);
+  PrintLog(kMessageType_Info, "Link status - good: %llums, degraded: %llums, poor: %llums, lost: %llums\n",
+          (unsigned long long)(state_time_us[kLinkState_Good] / 1000), (unsigned long long)(state_time_us[kLinkState_Degraded] / 1000),
+          (unsigned long long)(state_time_us[kLinkState_Poor] / 1000), (unsigned long long)(state_time_us[kLinkState_Lost] / 1000));
+}
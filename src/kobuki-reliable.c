@@ -0,0 +1,357 @@
+#include "kobuki.h"
+
+#define RELIABLE_LOSS_GAIN (1.0f / 16.0f)
+
+/**
+ * @brief sub-payload 에 해당하는 상태 슬롯을 찾는다.
+ * @param[in] sub_payload_id KOBUKI sub-payload id
+ * @param[in] create 없으면 새로 할당
+ * @return 상태 슬롯, 없으면 NULL
+ */
+static struct ReliableState *FindReliableState(uint8_t sub_payload_id, bool create)
+{
+  struct ReliableStatus *reliable = &g_mib.reliable;
+
+  for (int i = 0; i < reliable->states_size; i++) {
+    if (reliable->states[i].sub_payload_id == sub_payload_id) {
+      return &reliable->states[i];
+    }
+  }
+  if (create == false || reliable->states_size >= RELIABLE_STATE_MAX) {
+    return NULL;
+  }
+
+  struct ReliableState *state = &reliable->states[reliable->states_size++];
+  memset(state, 0x00, sizeof(struct ReliableState));
+  state->sub_payload_id = sub_payload_id;
+  state->acked = true;
+  return state;
+}
+
+/**
+ * @brief 손실률(EWMA)을 갱신한다.
+ * @param[in] lost 손실 여부
+ */
+static void UpdateReliableLoss(bool lost)
+{
+  struct ReliableStatus *reliable = &g_mib.reliable;
+
+  reliable->loss_rate *= (1.0f - RELIABLE_LOSS_GAIN);
+  if (lost) {
+    reliable->loss_rate += RELIABLE_LOSS_GAIN;
+    reliable->lost_count++;
+  }
+}
+
+/**
+ * @brief RTT 측정값으로 srtt, rttvar, rto 를 갱신한다. (RFC 6298)
+ * @param[in] rtt_us 측정한 RTT us 단위
+ */
+static void UpdateReliableRTT(int rtt_us)
+{
+  struct ReliableStatus *reliable = &g_mib.reliable;
+
+  if (reliable->srtt_us == 0) {
+    reliable->srtt_us = rtt_us;
+    reliable->rttvar_us = rtt_us / 2;
+  }
+  else {
+    int err = rtt_us - reliable->srtt_us;
+    reliable->srtt_us += err / 8;
+    reliable->rttvar_us += ((err < 0 ? -err : err) - reliable->rttvar_us) / 4;
+  }
+  if (reliable->rtt_min_us == 0 || rtt_us < reliable->rtt_min_us) {
+    reliable->rtt_min_us = rtt_us;
+  }
+  if (rtt_us > reliable->rtt_max_us) {
+    reliable->rtt_max_us = rtt_us;
+  }
+
+  reliable->rto_us = reliable->srtt_us + 4 * reliable->rttvar_us;
+  if (reliable->rto_us < RELIABLE_RTO_MIN_MS * 1000) {
+    reliable->rto_us = RELIABLE_RTO_MIN_MS * 1000;
+  }
+  if (reliable->rto_us > RELIABLE_RTO_MAX_MS * 1000) {
+    reliable->rto_us = RELIABLE_RTO_MAX_MS * 1000;
+  }
+}
+
+/**
+ * @brief 상태 슬롯의 최신 epoch 를 새 seq 로 전송한다.
+ * @param[in] state 상태 슬롯
+ * @param[in] now_us 현재 시각
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ */
+static int TransmitReliableState(struct ReliableState *state, uint64_t now_us)
+{
+  struct ReliableStatus *reliable = &g_mib.reliable;
+  uint8_t buf[sizeof(struct TimedCommandHeader) + RELIABLE_FRAME_MAX_LEN];
+  struct TimedCommandHeader *timed = (struct TimedCommandHeader *)buf;
+  struct ReliableHeader *header = &timed->header;
+  size_t header_len = sizeof(struct ReliableHeader);
+
+  header->magic = RELIABLE_MAGIC;
+  header->frame_type = kFrameType_Command;
+  header->session = reliable->session;
+  header->seq = reliable->next_seq++;
+  header->epoch = state->epoch;
+  uint32_t exec_time_us;
+  if (state->exec_time_us != 0 && GetBridgeTime(state->exec_time_us, &exec_time_us)) {
+    header->frame_type = kFrameType_TimedCommand;
+    timed->exec_time_us = exec_time_us;
+    header_len = sizeof(struct TimedCommandHeader);
+  }
+  memcpy(buf + header_len, state->frame, state->frame_len);
+
+  /* 재전송 시점까지 ack 되지 않은 이전 전송은 손실로 본다. */
+  struct ReliableSent *sent = &reliable->sent[state->last_seq % RELIABLE_SENT_WINDOW];
+  if (state->acked == false && sent->pending && sent->seq == state->last_seq) {
+    sent->pending = false;
+    UpdateReliableLoss(true);
+  }
+
+  /* 덮어쓰는 송신 기록이 ack 되지 않았다면 손실로 본다. */
+  sent = &reliable->sent[header->seq % RELIABLE_SENT_WINDOW];
+  if (sent->pending) {
+    UpdateReliableLoss(true);
+  }
+  sent->seq = header->seq;
+  sent->send_us = now_us;
+  sent->pending = true;
+  sent->acked = false;
+
+  state->last_seq = header->seq;
+  state->last_send_us = now_us;
+  reliable->last_tx_us = now_us;
+  reliable->tx_count++;
+
+  /* link 상태가 나쁘면 같은 seq 로 여러 번 보낸다. bridge 는 epoch 로 중복을 버린다. */
+  int copies = GetLinkCopies(state->sub_payload_id);
+  int ret = SendUDPMessage(g_mib.socket, g_mib.server_addr, (char *)buf, header_len + state->frame_len);
+  for (int i = 1; i < copies; i++) {
+    SendUDPMessage(g_mib.socket, g_mib.server_addr, (char *)buf, header_len + state->frame_len);
+    g_mib.link.duplicate_count++;
+  }
+  return ret;
+}
+
+/**
+ * @brief Initialize reliable layer
+ * @param[out] reliable reliable layer 상태
+ */
+void InitReliable(struct ReliableStatus *reliable)
+{
+  memset(reliable, 0x00, sizeof(struct ReliableStatus));
+  reliable->session = (uint16_t)(getpid() ^ GetTimeUs());
+  reliable->rto_us = RELIABLE_RTO_INIT_MS * 1000;
+}
+
+/**
+ * @brief sub-payload 의 새 상태를 전송한다. ack 될 때까지 최신 상태만 재전송된다.
+ * @details SetCommandTime() 으로 실행 시각이 지정되어 있으면 bridge 가 해당 시각에 실행한다.
+ * @param[in] sub_payload_id KOBUKI sub-payload id
+ * @param[in] frame KOBUKI 패킷 (header, crc 포함)
+ * @param[in] frame_len KOBUKI 패킷 길이
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ */
+int SendReliableState(uint8_t sub_payload_id, const uint8_t *frame, size_t frame_len)
+{
+  return SendReliableStateAt(sub_payload_id, frame, frame_len, g_mib.command_time_us);
+}
+
+/**
+ * @brief sub-payload 의 새 상태를 지정한 시각에 실행되도록 전송한다.
+ * @param[in] sub_payload_id KOBUKI sub-payload id
+ * @param[in] frame KOBUKI 패킷 (header, crc 포함)
+ * @param[in] frame_len KOBUKI 패킷 길이
+ * @param[in] exec_time_us 실행 시각 (driver 시계), 0: 즉시 실행
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ */
+int SendReliableStateAt(uint8_t sub_payload_id, const uint8_t *frame, size_t frame_len, uint64_t exec_time_us)
+{
+  if (frame_len > RELIABLE_FRAME_MAX_LEN) {
+    PrintLog(kMessageType_Error, "Fail to send reliable state - frame_len: %d\n", (int)frame_len);
+    return -1;
+  }
+
+  struct ReliableState *state = FindReliableState(sub_payload_id, true);
+  if (state == NULL) {
+    PrintLog(kMessageType_Error, "Fail to send reliable state - no slot for sub_payload_id: 0x%02X\n", sub_payload_id);
+    return -1;
+  }
+
+  uint64_t now_us = GetTimeUs();
+  state->epoch++;
+  state->acked = true; // 이전 epoch 의 전송은 손실 판정에서 제외
+  state->first_send_us = now_us;
+  state->trace_send_ns = TRACE_NOW();
+  state->command_id = g_mib.command_id;
+  state->exec_time_us = exec_time_us;
+  memcpy(state->frame, frame, frame_len);
+  state->frame_len = frame_len;
+
+  int ret = TransmitReliableState(state, now_us);
+  state->acked = false;
+  return ret;
+}
+
+/**
+ * @brief bridge 의 ack 를 처리한다.
+ * @param[in] buf 수신한 ack frame
+ * @param[in] len ack frame 길이
+ * @param[in] now_us 수신 시각
+ * @retval 0: 성공
+ * @retval 음수: 잘못된 ack
+ * @details link 상태가 나쁘면 같은 seq 로 여러 사본을 보내므로 ack 도 여러 번 온다.
+ *          seq 별로 첫 ack 만 ack 수, 손실률, RTT 에 반영한다.
+ */
+int HandleReliableAck(const uint8_t *buf, size_t len, uint64_t now_us)
+{
+  struct ReliableStatus *reliable = &g_mib.reliable;
+  const struct ReliableAckFormat *ack = (const struct ReliableAckFormat *)buf;
+
+  if (len < sizeof(struct ReliableAckFormat) || ack->header.session != reliable->session) {
+    return -1;
+  }
+
+  struct ReliableSent *sent = &reliable->sent[ack->header.seq % RELIABLE_SENT_WINDOW];
+  if (sent->seq == ack->header.seq && sent->acked) {
+    reliable->duplicate_ack_count++;
+    return 0;
+  }
+  reliable->ack_count++;
+  if (sent->seq == ack->header.seq) {
+    sent->acked = true;
+  }
+  if (sent->pending && sent->seq == ack->header.seq) {
+    sent->pending = false;
+    UpdateReliableLoss(false);
+    UpdateReliableRTT((int)(now_us - sent->send_us));
+  }
+
+  struct ReliableState *state = FindReliableState(ack->sub_payload_id, false);
+  if (state == NULL || state->epoch != ack->header.epoch) {
+    reliable->stale_ack_count++;
+    return 0;
+  }
+  if (state->acked == false) {
+    state->acked = true;
+    TRACE_END_ID(state->trace_send_ns, "ack_confirm", state->command_id);
+    int state_time_us = (int)(now_us - state->first_send_us);
+    if (state_time_us > reliable->state_time_max_us) {
+      reliable->state_time_max_us = state_time_us;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief ack 되지 않은 최신 상태를 rto 간격으로 재전송한다.
+ * @param[in] now_us 현재 시각
+ * @return 다음 재전송까지 남은 시간 ms 단위, 재전송할 상태가 없으면 -1
+ */
+int ServiceReliable(uint64_t now_us)
+{
+  struct ReliableStatus *reliable = &g_mib.reliable;
+  int next_ms = -1;
+
+  for (int i = 0; i < reliable->states_size; i++) {
+    struct ReliableState *state = &reliable->states[i];
+    if (state->acked) {
+      continue;
+    }
+
+    uint64_t due_us = state->last_send_us + reliable->rto_us;
+    if (now_us >= due_us) {
+      reliable->retransmit_count++;
+      PrintLog(kMessageType_Debug, "Retransmit reliable state - sub_payload_id: 0x%02X, epoch: %d\n", state->sub_payload_id, state->epoch);
+      TRACE_BEGIN(trace_span);
+      TransmitReliableState(state, now_us);
+      TRACE_END_ID(trace_span, "retransmit", state->command_id);
+      due_us = now_us + reliable->rto_us;
+    }
+
+    int wait_ms = (int)((due_us - now_us + 999) / 1000);
+    if (next_ms < 0 || wait_ms < next_ms) {
+      next_ms = wait_ms;
+    }
+  }
+  return next_ms;
+}
+
+/**
+ * @brief ack 된 최신 상태를 다시 전송해서 link 의 손실률, RTT 를 측정한다.
+ * @param[in] sub_payload_id KOBUKI sub-payload id
+ * @param[in] now_us 현재 시각
+ * @retval 0: 성공
+ * @retval 음수: 상태 없음 또는 전송 실패
+ * @details bridge 는 같은 epoch 를 실행하지 않고 ack 만 보낸다.
+ *          ack 되지 않은 상태는 재전송이 keepalive 역할을 하므로 보내지 않는다.
+ */
+int SendReliableKeepalive(uint8_t sub_payload_id, uint64_t now_us)
+{
+  struct ReliableStatus *reliable = &g_mib.reliable;
+  struct ReliableState *state = FindReliableState(sub_payload_id, false);
+
+  if (state == NULL || state->epoch == 0) {
+    return -1;
+  }
+  if (state->acked == false) {
+    return 0;
+  }
+
+  /* 다음 keepalive 까지 ack 되지 않은 이전 keepalive 는 손실로 본다. */
+  struct ReliableSent *sent = &reliable->sent[reliable->keepalive_seq % RELIABLE_SENT_WINDOW];
+  if (reliable->keepalive_pending && sent->pending && sent->seq == reliable->keepalive_seq) {
+    sent->pending = false;
+    UpdateReliableLoss(true);
+  }
+
+  int ret = TransmitReliableState(state, now_us);
+  reliable->keepalive_seq = state->last_seq;
+  reliable->keepalive_pending = true;
+  g_mib.link.keepalive_count++;
+  return ret;
+}
+
+/**
+ * @brief 모든 최신 상태가 ack 되었는지 확인한다.
+ */
+bool IsReliableSettled(void)
+{
+  for (int i = 0; i < g_mib.reliable.states_size; i++) {
+    if (g_mib.reliable.states[i].acked == false) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief sub-payload 의 최신 상태가 ack 되었는지 확인한다.
+ * @param[in] sub_payload_id KOBUKI sub-payload id
+ */
+bool IsReliableStateAcked(uint8_t sub_payload_id)
+{
+  struct ReliableState *state = FindReliableState(sub_payload_id, false);
+
+  return state == NULL || state->acked;
+}
+
+/**
+ * @brief reliable layer 통계 출력
+ */
+void PrintReliableStatus(void)
+{
+  struct ReliableStatus *reliable = &g_mib.reliable;
+
+  PrintLog(kMessageType_Info, "Reliable status - tx: %u, retransmit: %u, ack: %u, duplicate_ack: %u, stale_ack: %u, lost: %u, loss_rate: %.1f%%\n",
+          reliable->tx_count, reliable->retransmit_count, reliable->ack_count, reliable->duplicate_ack_count, reliable->stale_ack_count,
+          reliable->lost_count, reliable->loss_rate * 100.0f);
+  PrintLog(kMessageType_Info, "Reliable status - srtt: %dus, rttvar: %dus, rtt_min: %dus, rtt_max: %dus, rto: %dus, state_time_max: %dus\n",
+          reliable->srtt_us, reliable->rttvar_us, reliable->rtt_min_us, reliable->rtt_max_us,
+          reliable->rto_us, reliable->state_time_max_us);
+}
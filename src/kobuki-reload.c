@@ -0,0 +1,211 @@
+#include <libgen.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+#include "kobuki.h"
+
+/**
+ * @brief watch thread 인자
+ */
+struct ScriptWatch
+{
+  int inotify_fd;
+  int event_fd;
+  char path[PATH_MAX]; ///< script 파일 경로
+  char name[NAME_MAX + 1]; ///< 디렉터리 안의 파일 이름
+};
+
+/* g_mib.scripts[] 중 실행 중이 아닌 buffer 와 g_reload_pending 을 보호한다. */
+static pthread_mutex_t g_reload_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool g_reload_pending; ///< 실행 중이 아닌 buffer 에 검증된 script 가 있음
+
+/**
+ * @brief 새로 읽은 script 를 실행 전에 검증한다.
+ * @param[in] script 새로 읽은 script
+ * @retval 0: 성공
+ * @retval -1: 실패
+ * @details 시작할 때는 범위를 벗어난 값을 ClampScriptValue() 로 제한해서 실행하지만, 실행 중에 교체할 script 는
+ *          제한된 값이 하나라도 있으면 거부한다.
+ */
+static int ValidateScript(const struct Script *script)
+{
+  if (script->lines_size <= 0) {
+    PrintLog(kMessageType_Error, "Fail to validate script - no command\n");
+    return -1;
+  }
+  for (int i = 0; i < script->lines_size; i++) {
+    const struct ScriptLine *line = &script->lines[i];
+    if (line->clamped) {
+      PrintLog(kMessageType_Error, "Fail to validate script - #%d: value out of range\n", i);
+      return -1;
+    }
+    switch (line->type) {
+      case kCommandType_Speed:
+        if (isfinite(line->radian) == false) {
+          PrintLog(kMessageType_Error, "Fail to validate script - #%d: radian: %f\n", i, line->radian);
+          return -1;
+        }
+        break;
+      case kCommandType_Sleep:
+        if (line->delay < 0) {
+          PrintLog(kMessageType_Error, "Fail to validate script - #%d: delay: %d\n", i, line->delay);
+          return -1;
+        }
+        break;
+      case kCommandType_LED:
+        if (line->led_num < 1 || line->led_num > 2 || line->color < kLEDColor_None || line->color > kLEDColor_Red) {
+          PrintLog(kMessageType_Error, "Fail to validate script - #%d: led_num: %d, color: %d\n", i, line->led_num, line->color);
+          return -1;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief script 파일을 읽고, 검증되면 실행 중이 아닌 buffer 에 넣어 교체를 요청한다.
+ * @param[in] watch watch 상태
+ * @details watch thread 의 buffer 에 먼저 읽으므로 실패해도 실행 중인 script 와 교체 대기 중인 script 는 바뀌지 않는다.
+ *          교체 전에 다시 읽으면 교체 대기 중인 script 를 새 script 로 바꾼다.
+ */
+static void ReloadScript(struct ScriptWatch *watch)
+{
+  static struct Script script;
+
+  if (ParseScriptCommand(watch->path, &g_mib.profile, &script) < 0 || ValidateScript(&script) < 0) {
+    PrintLog(kMessageType_Error, "Fail to reload script - %s, keep the running script\n", watch->path);
+    return;
+  }
+
+  pthread_mutex_lock(&g_reload_mutex);
+  struct Script *next = (g_mib.script == &g_mib.scripts[0]) ? &g_mib.scripts[1] : &g_mib.scripts[0];
+  memcpy(next, &script, sizeof(struct Script));
+  g_reload_pending = true;
+  pthread_mutex_unlock(&g_reload_mutex);
+
+  PrintLog(kMessageType_Pass, "Success to reload script - %s, lines_size: %d\n", watch->path, script.lines_size);
+  uint64_t count = 1;
+  if (write(watch->event_fd, &count, sizeof(count)) != sizeof(count)) {
+    PrintLog(kMessageType_Error, "Fail to write reload eventfd\n");
+  }
+}
+
+/**
+ * @brief script 파일이 다시 쓰여지면 읽어서 교체를 요청하는 watch thread
+ * @details 편집기는 파일을 덮어쓰거나 새 파일로 rename 하므로 디렉터리를 감시한다.
+ */
+static void *ScriptWatchThread(void *arg)
+{
+  struct ScriptWatch *watch = (struct ScriptWatch *)arg;
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while (true) {
+    ssize_t len = read(watch->inotify_fd, buf, sizeof(buf));
+    if (len <= 0) {
+      if (len < 0 && errno == EINTR) {
+        continue;
+      }
+      PrintLog(kMessageType_Error, "Fail to read inotify - len: %d\n", (int)len);
+      return NULL;
+    }
+
+    bool changed = false;
+    for (char *ptr = buf; ptr < buf + len; ) {
+      const struct inotify_event *event = (const struct inotify_event *)ptr;
+      if (event->len > 0 && strcmp(event->name, watch->name) == 0) {
+        changed = true;
+      }
+      ptr += sizeof(struct inotify_event) + event->len;
+    }
+    if (changed) {
+      ReloadScript(watch);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief script 파일 감시용 inotify, eventfd 와 watch thread 를 만든다.
+ * @param[in] script_file script 파일 이름(경로)
+ * @param[out] event_fd 새 script 를 읽으면 읽을 수 있게 되는 eventfd, WaitEventUntil() 에서 poll 한다
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ */
+int StartScriptWatch(const char *script_file, int *event_fd)
+{
+  static struct ScriptWatch watch;
+  char dir[PATH_MAX];
+  char base[PATH_MAX];
+  pthread_t thread;
+
+  if (strlen(script_file) >= sizeof(watch.path)) {
+    PrintLog(kMessageType_Error, "Fail to watch script file - too long path\n");
+    return -1;
+  }
+  strcpy(watch.path, script_file);
+  strcpy(dir, script_file);
+  strcpy(base, script_file);
+  snprintf(watch.name, sizeof(watch.name), "%s", basename(base));
+
+  watch.inotify_fd = inotify_init1(IN_CLOEXEC);
+  if (watch.inotify_fd < 0) {
+    PrintLog(kMessageType_Error, "Fail to create inotify - errno: %d\n", errno);
+    return -1;
+  }
+  if (inotify_add_watch(watch.inotify_fd, dirname(dir), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    PrintLog(kMessageType_Error, "Fail to watch script file - %s, errno: %d\n", script_file, errno);
+    close(watch.inotify_fd);
+    return -1;
+  }
+
+  *event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (*event_fd < 0) {
+    PrintLog(kMessageType_Error, "Fail to create eventfd - event_fd: %d\n", *event_fd);
+    close(watch.inotify_fd);
+    return -1;
+  }
+  watch.event_fd = *event_fd;
+
+  sigset_t old_mask;
+  BlockTerminateSignals(&old_mask);
+  int ret = pthread_create(&thread, NULL, ScriptWatchThread, &watch);
+  pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+  if (ret != 0) {
+    PrintLog(kMessageType_Error, "Fail to create script watch thread\n");
+    close(watch.inotify_fd);
+    close(*event_fd);
+    *event_fd = -1;
+    return -1;
+  }
+  pthread_detach(thread);
+  PrintLog(kMessageType_Pass, "Success to watch script file - %s\n", script_file);
+  return 0;
+}
+
+/**
+ * @brief 검증된 새 script 가 있으면 실행 중인 script 와 교체한다. executor 가 명령 사이에서 호출한다.
+ * @retval true: 교체함, 새 script 를 처음부터 실행한다.
+ * @retval false: 새 script 없음
+ */
+bool SwapScript(void)
+{
+  bool swapped = false;
+
+  pthread_mutex_lock(&g_reload_mutex);
+  if (g_reload_pending) {
+    g_mib.script = (g_mib.script == &g_mib.scripts[0]) ? &g_mib.scripts[1] : &g_mib.scripts[0];
+    g_reload_pending = false;
+    swapped = true;
+  }
+  pthread_mutex_unlock(&g_reload_mutex);
+  if (swapped) {
+    PrintLog(kMessageType_Pass, "Success to swap script - lines_size: %d\n", g_mib.script->lines_size);
+  }
+  return swapped;
+}
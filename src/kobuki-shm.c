@@ -0,0 +1,395 @@
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/futex.h>
+
+#include "kobuki.h"
+
+/**
+ * @brief helper thread 인자
+ */
+struct SharedNotify
+{
+  struct SharedRegion *region;
+  int event_fd;
+  uint32_t seen_seq; ///< thread 생성 전에 읽어, 생성 직후 쓰여진 명령도 알린다
+  pthread_t thread;
+  bool running;
+  bool stop; ///< StopSharedNotify() 의 종료 요청
+};
+
+static struct SharedNotify g_notify;
+
+static int Futex(uint32_t *word, int op, uint32_t value, const struct timespec *timeout)
+{
+  return (int)syscall(SYS_futex, word, op, value, timeout, NULL, 0);
+}
+
+/**
+ * @brief seqlock 쓰기 시작. 여러 writer 가 있어도 되도록 seq 를 홀수로 만드는 쪽이 쓴다.
+ * @param[in] seq seqlock
+ * @return 쓰기 전 seq (짝수)
+ */
+static uint32_t BeginSeqWrite(uint32_t *seq)
+{
+  uint32_t old_seq;
+
+  while (true) {
+    old_seq = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    if ((old_seq & 1) == 0 &&
+        __atomic_compare_exchange_n(seq, &old_seq, old_seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  return old_seq;
+}
+
+/**
+ * @brief seqlock 쓰기 종료, 대기 중인 프로세스가 있으면 깨운다.
+ * @param[in] seq seqlock
+ * @param[in] waiters 대기 중인 프로세스 수
+ * @param[in] old_seq BeginSeqWrite() 의 반환값
+ */
+static void EndSeqWrite(uint32_t *seq, uint32_t *waiters, uint32_t old_seq)
+{
+  __atomic_store_n(seq, old_seq + 2, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(waiters, __ATOMIC_SEQ_CST) != 0) {
+    Futex(seq, FUTEX_WAKE, INT_MAX, NULL);
+  }
+}
+
+/**
+ * @brief seqlock 으로 보호된 데이터를 복사한다.
+ * @param[in] seq seqlock
+ * @param[out] dst 복사할 버퍼
+ * @param[in] src 공유 메모리 데이터
+ * @param[in] len 데이터 길이
+ * @return 복사한 데이터의 seq
+ */
+static uint32_t ReadSeq(uint32_t *seq, void *dst, const void *src, size_t len)
+{
+  while (true) {
+    uint32_t begin_seq = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+    if (begin_seq & 1) {
+      continue;
+    }
+    memcpy(dst, src, len);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(seq, __ATOMIC_RELAXED) == begin_seq) {
+      return begin_seq;
+    }
+  }
+}
+
+/**
+ * @brief seq 가 주어진 값에서 바뀔 때까지 futex 로 대기한다.
+ * @param[in] seq seqlock
+ * @param[in] waiters 대기 중인 프로세스 수
+ * @param[in] old_seq 마지막으로 확인한 seq
+ * @param[in] timeout_ms 최대 대기 시간 ms 단위, 음수: 무한 대기
+ * @retval 0: seq 변경
+ * @retval 음수: 시간 초과
+ */
+static int WaitSeq(uint32_t *seq, uint32_t *waiters, uint32_t old_seq, int timeout_ms)
+{
+  struct timespec timeout;
+  struct timespec *timeout_ptr = NULL;
+
+  if (timeout_ms >= 0) {
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000;
+    timeout_ptr = &timeout;
+  }
+
+  __atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+  int ret = 0;
+  while (__atomic_load_n(seq, __ATOMIC_SEQ_CST) == old_seq) {
+    if (Futex(seq, FUTEX_WAIT, old_seq, timeout_ptr) < 0 && errno == ETIMEDOUT) {
+      ret = -1;
+      break;
+    }
+  }
+  __atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+  return ret;
+}
+
+/**
+ * @brief 공유 메모리 영역을 연다.
+ * @param[in] name 공유 메모리 이름 ("/kobuki")
+ * @param[in] create true: driver 가 새로 만든다, false: client 가 기존 영역을 연다
+ * @param[out] region 공유 메모리 영역
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ */
+int OpenSharedRegion(const char *name, bool create, struct SharedRegion **region)
+{
+  int fd = shm_open(name, create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0600);
+  if (fd < 0) {
+    PrintLog(kMessageType_Error, "Fail to open shared memory - name: %s, errno: %d\n", name, errno);
+    return -1;
+  }
+  if (create && ftruncate(fd, sizeof(struct SharedRegion)) < 0) {
+    PrintLog(kMessageType_Error, "Fail to resize shared memory - name: %s\n", name);
+    close(fd);
+    return -1;
+  }
+
+  void *ptr = mmap(NULL, sizeof(struct SharedRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    PrintLog(kMessageType_Error, "Fail to map shared memory - name: %s\n", name);
+    return -1;
+  }
+
+  struct SharedRegion *shared = (struct SharedRegion *)ptr;
+  if (create) {
+    memset(shared, 0x00, sizeof(struct SharedRegion));
+    shared->version = SHARED_VERSION;
+    shared->size = sizeof(struct SharedRegion);
+    shared->driver_pid = getpid();
+    __atomic_store_n(&shared->magic, SHARED_MAGIC, __ATOMIC_RELEASE);
+  }
+  else if (__atomic_load_n(&shared->magic, __ATOMIC_ACQUIRE) != SHARED_MAGIC ||
+           shared->version != SHARED_VERSION || shared->size != sizeof(struct SharedRegion)) {
+    PrintLog(kMessageType_Error, "Fail to check shared memory - name: %s, version: %u\n", name, shared->version);
+    munmap(ptr, sizeof(struct SharedRegion));
+    return -1;
+  }
+
+  *region = shared;
+  PrintLog(kMessageType_Pass, "Success to open shared memory - name: %s\n", name);
+  return 0;
+}
+
+/**
+ * @brief 공유 메모리 영역을 닫는다.
+ * @param[in] region 공유 메모리 영역
+ * @param[in] name 공유 메모리 이름
+ * @param[in] remove true: 이름을 삭제한다 (driver)
+ */
+void CloseSharedRegion(struct SharedRegion *region, const char *name, bool remove)
+{
+  munmap(region, sizeof(struct SharedRegion));
+  if (remove) {
+    shm_unlink(name);
+  }
+}
+
+/**
+ * @brief set-point 를 command mailbox 에 쓴다. 이전 명령은 덮어쓴다 (최신 값만 유효).
+ * @param[in] region 공유 메모리 영역
+ * @param[in] command 명령, command_id 와 publish_us 는 무시된다
+ * @return 할당한 command_id
+ */
+uint32_t PublishSharedCommand(struct SharedRegion *region, const struct SharedCommand *command)
+{
+  uint32_t command_id = __atomic_add_fetch(&region->next_command_id, 1, __ATOMIC_RELAXED);
+  uint32_t old_seq = BeginSeqWrite(&region->command_seq);
+
+  region->command = *command;
+  region->command.command_id = command_id;
+  region->command.publish_us = GetTimeUs();
+  EndSeqWrite(&region->command_seq, &region->command_waiters, old_seq);
+  return command_id;
+}
+
+/**
+ * @brief command mailbox 를 읽는다.
+ * @param[in] region 공유 메모리 영역
+ * @param[out] command 명령
+ * @return command mailbox 의 seq
+ */
+uint32_t ReadSharedCommand(struct SharedRegion *region, struct SharedCommand *command)
+{
+  return ReadSeq(&region->command_seq, command, &region->command, sizeof(struct SharedCommand));
+}
+
+/**
+ * @brief sensor-state snapshot 을 쓴다.
+ * @param[in] region 공유 메모리 영역
+ * @param[in] state sensor-state snapshot
+ */
+void PublishSharedState(struct SharedRegion *region, const struct SharedState *state)
+{
+  uint32_t old_seq = BeginSeqWrite(&region->state_seq);
+
+  region->state = *state;
+  EndSeqWrite(&region->state_seq, &region->state_waiters, old_seq);
+}
+
+/**
+ * @brief sensor-state snapshot 을 읽는다.
+ * @param[in] region 공유 메모리 영역
+ * @param[out] state sensor-state snapshot
+ * @return snapshot 의 seq, WaitSharedState() 에 전달한다
+ */
+uint32_t ReadSharedState(struct SharedRegion *region, struct SharedState *state)
+{
+  return ReadSeq(&region->state_seq, state, &region->state, sizeof(struct SharedState));
+}
+
+/**
+ * @brief 새 sensor-state snapshot 이 쓰여질 때까지 대기한다.
+ * @param[in] region 공유 메모리 영역
+ * @param[in] seq ReadSharedState() 의 반환값
+ * @param[in] timeout_ms 최대 대기 시간 ms 단위, 음수: 무한 대기
+ * @retval 0: 새 snapshot
+ * @retval 음수: 시간 초과
+ */
+int WaitSharedState(struct SharedRegion *region, uint32_t seq, int timeout_ms)
+{
+  return WaitSeq(&region->state_seq, &region->state_waiters, seq, timeout_ms);
+}
+
+/**
+ * @brief command mailbox 를 futex 로 기다렸다가 eventfd 로 알리는 helper thread
+ * @details 종료 요청은 futex wake 로 바로 확인한다. wake 가 대기 직전에 오면 SHARED_NOTIFY_CHECK_MS 안에 확인한다.
+ */
+static void *SharedNotifyThread(void *arg)
+{
+  struct SharedNotify *notify = (struct SharedNotify *)arg;
+  struct SharedRegion *region = notify->region;
+  uint32_t seen_seq = notify->seen_seq;
+  struct timespec timeout = { 0, SHARED_NOTIFY_CHECK_MS * 1000000L };
+
+  while (__atomic_load_n(&notify->stop, __ATOMIC_SEQ_CST) == false) {
+    __atomic_add_fetch(&region->command_waiters, 1, __ATOMIC_SEQ_CST);
+    Futex(&region->command_seq, FUTEX_WAIT, seen_seq, &timeout);
+    __atomic_sub_fetch(&region->command_waiters, 1, __ATOMIC_SEQ_CST);
+
+    uint32_t seq = __atomic_load_n(&region->command_seq, __ATOMIC_ACQUIRE);
+    if (seq == seen_seq) {
+      continue;
+    }
+    seen_seq = seq;
+    if ((seen_seq & 1) == 0) {
+      uint64_t count = 1;
+      if (write(notify->event_fd, &count, sizeof(count)) != sizeof(count)) {
+        PrintLog(kMessageType_Error, "Fail to write shared memory eventfd\n");
+      }
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief command mailbox 알림용 eventfd 와 helper thread 를 만든다.
+ * @param[in] region 공유 메모리 영역
+ * @param[out] event_fd 명령이 쓰여지면 읽을 수 있게 되는 eventfd, WaitEventUntil() 에서 poll 한다
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ * @details 공유 메모리를 닫기 전에 StopSharedNotify() 로 thread 를 종료해야 한다.
+ */
+int StartSharedNotify(struct SharedRegion *region, int *event_fd)
+{
+  struct SharedNotify *notify = &g_notify;
+
+  *event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (*event_fd < 0) {
+    PrintLog(kMessageType_Error, "Fail to create eventfd - event_fd: %d\n", *event_fd);
+    return -1;
+  }
+
+  notify->region = region;
+  notify->event_fd = *event_fd;
+  notify->seen_seq = __atomic_load_n(&region->command_seq, __ATOMIC_ACQUIRE) & ~1u;
+  notify->stop = false;
+  sigset_t old_mask;
+  BlockTerminateSignals(&old_mask);
+  int ret = pthread_create(&notify->thread, NULL, SharedNotifyThread, notify);
+  pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+  if (ret != 0) {
+    PrintLog(kMessageType_Error, "Fail to create shared memory notify thread\n");
+    close(*event_fd);
+    *event_fd = -1;
+    return -1;
+  }
+  notify->running = true;
+  return 0;
+}
+
+/**
+ * @brief helper thread 를 종료하고 기다린다. 이후에는 공유 메모리 영역을 닫아도 된다.
+ */
+void StopSharedNotify(void)
+{
+  struct SharedNotify *notify = &g_notify;
+
+  if (notify->running == false) {
+    return;
+  }
+  __atomic_store_n(&notify->stop, true, __ATOMIC_SEQ_CST);
+  Futex(&notify->region->command_seq, FUTEX_WAKE, INT_MAX, NULL);
+  pthread_join(notify->thread, NULL);
+  notify->running = false;
+  close(notify->event_fd);
+}
+
+/**
+ * @brief driver 의 feedback, reflex, link 상태로 sensor-state snapshot 을 쓴다.
+ */
+void UpdateSharedState(void)
+{
+  struct SharedState state;
+
+  if (g_mib.shared == NULL) {
+    return;
+  }
+  memset(&state, 0x00, sizeof(struct SharedState));
+  state.basic_sensor = g_mib.feedback.basic_sensor;
+  state.inertial_sensor = g_mib.feedback.inertial_sensor;
+  state.valid = g_mib.feedback.valid;
+  state.feedback_us = g_mib.feedback.last_update_us;
+  state.reflex_active = g_mib.reflex.active;
+  state.reflex_count = g_mib.reflex.count;
+  state.applied_command_id = g_mib.shared_command_id;
+  state.rejected_command_id = g_mib.shared_rejected_id;
+  state.applied_us = GetTimeUs();
+  state.srtt_us = g_mib.reliable.srtt_us;
+  state.loss_rate = g_mib.reliable.loss_rate;
+  PublishSharedState(g_mib.shared, &state);
+}
+
+/**
+ * @brief command mailbox 의 최신 명령을 KOBUKI 로 전송하고 snapshot 에 반영한다.
+ * @retval 0: 새 명령 전송
+ * @retval 1: 새 명령 없음
+ * @details eventfd 알림 사이에 여러 명령이 쓰여지면 마지막 명령만 전송한다.
+ *          script 와 같이 센서가 눌린 채로는 전진 속도를 전송하지 않는다 (rejected_command_id). 후진, 정지는 허용한다.
+ */
+int ApplySharedCommand(void)
+{
+  struct SharedCommand command;
+
+  ReadSharedCommand(g_mib.shared, &command);
+  if (command.command_id == g_mib.shared_command_id) {
+    return 1;
+  }
+
+  SetCommandTime(0);
+  if (command.led_mask & SHARED_LED_1) {
+    KOBUKI_ControlLED(g_mib.device, 1, command.led_color[0]);
+  }
+  if (command.led_mask & SHARED_LED_2) {
+    KOBUKI_ControlLED(g_mib.device, 2, command.led_color[1]);
+  }
+  if (g_mib.reflex.active != kReflexType_None && command.speed > 0) {
+    g_mib.shared_rejected_id = command.command_id;
+    PrintLog(kMessageType_Info, "Reject shared speed command by reflex - id: %u, speed: %d, active: 0x%X\n",
+            command.command_id, command.speed, g_mib.reflex.active);
+  }
+  else {
+    KOBUKI_ControlSpeed(g_mib.device, command.speed, command.radius);
+  }
+  g_mib.shared_command_id = command.command_id;
+  UpdateSharedState();
+
+  PrintLog(kMessageType_Debug, "Apply shared command - id: %u, speed: %d, radius: %d, latency: %dus\n",
+          command.command_id, command.speed, command.radius, (int)(GetTimeUs() - command.publish_us));
+  return 0;
+}
@@ -0,0 +1,627 @@
+#include <math.h>
+#include <stddef.h>
+
+#include "kobuki.h"
+
+/**
+ * @brief --sim-config 파일의 항목
+ */
+static const struct ConfigKey g_sim_config_keys[] = {
+  { "rtt_us", offsetof(struct SimConfig, rtt_us), false },
+  { "feedback_ms", offsetof(struct SimConfig, feedback_ms), false },
+  { "loss", offsetof(struct SimConfig, loss), true },
+  { "seed", offsetof(struct SimConfig, seed), false },
+  { "loss_at_ms", offsetof(struct SimConfig, loss_at_ms), false },
+  { "loss_for_ms", offsetof(struct SimConfig, loss_for_ms), false },
+  { "outage_at_ms", offsetof(struct SimConfig, outage_at_ms), false },
+  { "outage_for_ms", offsetof(struct SimConfig, outage_for_ms), false },
+  { "bumper_at_ms", offsetof(struct SimConfig, bumper_at_ms), false },
+  { "bumper_for_ms", offsetof(struct SimConfig, bumper_for_ms), false },
+  { "bumper_every_ms", offsetof(struct SimConfig, bumper_every_ms), false },
+};
+
+/**
+ * @brief epoch 가 last 보다 새로운지 확인한다. (modulo 2^16)
+ */
+static bool IsNewerEpoch(uint16_t epoch, uint16_t last)
+{
+  uint16_t diff = (uint16_t)(epoch - last);
+  return (diff != 0 && diff < 0x8000);
+}
+
+/**
+ * @brief 시각이 첫 frame 부터 [at_ms, at_ms + for_ms) 구간 안인지 확인한다.
+ * @param[in] for_ms 구간 길이, 0: 끝까지
+ */
+static bool IsInSimWindow(uint64_t time_us, int at_ms, int for_ms)
+{
+  struct SimStatus *sim = &g_mib.sim;
+
+  if (sim->start_us == 0 || time_us < sim->start_us + (uint64_t)at_ms * 1000) {
+    return false;
+  }
+  return (for_ms <= 0 || time_us < sim->start_us + (uint64_t)(at_ms + for_ms) * 1000);
+}
+
+/**
+ * @brief 설정한 끊김 구간과 손실률로 frame 을 손실시킬지 정한다.
+ * @param[in] time_us frame 전송 시각
+ * @retval true: 손실
+ * @details xorshift32 난수를 쓰므로 seed 가 같으면 항상 같은 frame 이 손실된다.
+ */
+static bool LoseSimFrame(uint64_t time_us)
+{
+  struct SimStatus *sim = &g_mib.sim;
+  const struct SimConfig *config = &sim->config;
+
+  if (config->outage_at_ms >= 0 && IsInSimWindow(time_us, config->outage_at_ms, config->outage_for_ms)) {
+    sim->loss_count++;
+    return true;
+  }
+  if (config->loss <= 0.0f || IsInSimWindow(time_us, config->loss_at_ms, config->loss_for_ms) == false) {
+    return false;
+  }
+  uint32_t x = sim->random;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  sim->random = x;
+  if ((double)x / 4294967296.0 * 100 >= config->loss) {
+    return false;
+  }
+  sim->loss_count++;
+  return true;
+}
+
+/**
+ * @brief event 를 queue 에 추가한다.
+ * @param[in] due_us 실행 시각
+ * @param[in] apply true: bridge 가 KOBUKI 패킷 적용, false: driver 로 frame 전달
+ * @return 추가한 event, queue 가 가득 차면 NULL
+ */
+static struct SimEvent *PushSimEvent(uint64_t due_us, bool apply)
+{
+  struct SimStatus *sim = &g_mib.sim;
+
+  if (sim->queue_size >= SIM_QUEUE_MAX) {
+    PrintLog(kMessageType_Error, "Fail to queue simulated bridge event - queue_size: %d\n", sim->queue_size);
+    return NULL;
+  }
+  struct SimEvent *event = &sim->queue[sim->queue_size++];
+  memset(event, 0x00, sizeof(struct SimEvent));
+  event->due_us = due_us;
+  event->apply = apply;
+  return event;
+}
+
+/**
+ * @brief 가장 먼저 실행할 event 를 찾는다. 시각이 같으면 먼저 추가된 event
+ * @return queue index, 없으면 -1
+ */
+static int FindNextSimEvent(void)
+{
+  struct SimStatus *sim = &g_mib.sim;
+  int next = -1;
+
+  for (int i = 0; i < sim->queue_size; i++) {
+    if (next < 0 || sim->queue[i].due_us < sim->queue[next].due_us) {
+      next = i;
+    }
+  }
+  return next;
+}
+
+/**
+ * @brief KOBUKI 패킷 내용을 timeline 용 문자열로 만든다.
+ */
+static void DescribePacket(const uint8_t *packet, size_t packet_len, char *buf, size_t buf_size)
+{
+  uint16_t value[2] = { 0, 0 };
+
+  buf[0] = '\0';
+  if (packet_len < 7) {
+    return;
+  }
+  memcpy(value, packet + 5, (packet_len >= 9) ? 4 : 2);
+  switch (packet[3]) {
+    case BASE_CONTROL_ID:
+      snprintf(buf, buf_size, "speed=%d radius=%d", (int16_t)value[0], (int16_t)value[1]);
+      break;
+    case LED_CONTROL_ID:
+      snprintf(buf, buf_size, "led=0x%04X", value[0]);
+      break;
+    case REQUEST_EXTRA_ID:
+      snprintf(buf, buf_size, "request=0x%04X", value[0]);
+      break;
+  }
+}
+
+/**
+ * @brief frame timeline 에 한 줄을 기록한다.
+ * @param[in] time_us 시각
+ * @param[in] event tx, retransmit, keepalive, duplicate, sync, loss, apply, drop
+ * @param[in] header reliable header
+ * @param[in] sub_payload_id sub-payload id, 0: 없음
+ * @param[in] exec_us 실행 시각, 0: 즉시 실행
+ * @param[in] detail 패킷 내용
+ */
+static void WriteTimeline(uint64_t time_us, const char *event, const struct ReliableHeader *header,
+                          uint8_t sub_payload_id, uint64_t exec_us, const char *detail)
+{
+  FILE *timeline = g_mib.sim.timeline;
+
+  if (timeline == NULL) {
+    return;
+  }
+  fprintf(timeline, "%.3f,%s,%d,%u,%u,0x%02X,", (double)(int64_t)(time_us - g_mib.start_us) / 1000,
+          event, header->frame_type, header->seq, header->epoch, sub_payload_id);
+  if (exec_us != 0) {
+    fprintf(timeline, "%.3f", (double)(int64_t)(exec_us - g_mib.start_us) / 1000);
+  }
+  fprintf(timeline, ",%s\n", detail);
+}
+
+/**
+ * @brief 시뮬레이션 bridge 기본 설정
+ * @param[out] config 설정
+ */
+void InitSimConfig(struct SimConfig *config)
+{
+  memset(config, 0x00, sizeof(struct SimConfig));
+  config->rtt_us = SIM_RTT_DEFAULT_US;
+  config->feedback_ms = SIM_FEEDBACK_DEFAULT_MS;
+  config->seed = SIM_SEED_DEFAULT;
+  config->outage_at_ms = -1;
+  config->outage_for_ms = SIM_OUTAGE_FOR_DEFAULT_MS;
+  config->bumper_at_ms = -1;
+  config->bumper_for_ms = SIM_BUMPER_FOR_DEFAULT_MS;
+}
+
+/**
+ * @brief 시뮬레이션 bridge 설정 파일을 읽는다.
+ * @param[in] config_file 설정 파일 이름
+ * @param[in,out] config 파일에 있는 항목만 바뀐다.
+ * @retval 0: 성공
+ * @retval -1: 실패
+ * @details 파일 구조: 한 줄에 "<항목> <값>", '#' 으로 시작하는 줄은 주석
+ */
+int LoadSimConfig(const char *config_file, struct SimConfig *config)
+{
+  if (LoadConfigFile(config_file, g_sim_config_keys, sizeof(g_sim_config_keys) / sizeof(g_sim_config_keys[0]), config) < 0) {
+    PrintLog(kMessageType_Error, "Fail to load simulated bridge config - %s\n", config_file);
+    return -1;
+  }
+  PrintLog(kMessageType_Pass, "Success to load simulated bridge config - %s\n", config_file);
+  return 0;
+}
+
+/**
+ * @brief Initialize simulated bridge
+ * @param[out] sim 시뮬레이션 bridge 상태
+ * @param[in] config 시뮬레이션 bridge 설정
+ * @param[in] timeline_file frame timeline 파일 이름, 빈 문자열: 기록 안함
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ * @details bridge(wifi-linux.py) 와 같이 모든 명령을 ack 하고, 새 epoch 만 실행 시각에 적용한다.
+ *          bridge 시계는 driver 시계와 같다고 가정한다. 첫 frame 을 받은 뒤부터 sensor feedback 을 보낸다.
+ */
+int InitSim(struct SimStatus *sim, const struct SimConfig *config, const char *timeline_file)
+{
+  memset(sim, 0x00, sizeof(struct SimStatus));
+  sim->config = *config;
+  sim->random = (config->seed != 0) ? (uint32_t)config->seed : SIM_SEED_DEFAULT;
+  sim->wall_start_us = GetMonotonicTimeUs();
+  sim->move_us = GetTimeUs();
+
+  if (timeline_file[0] != '\0') {
+    sim->timeline = fopen(timeline_file, "w");
+    if (sim->timeline == NULL) {
+      PrintLog(kMessageType_Error, "Fail to open timeline file - %s\n", timeline_file);
+      return -1;
+    }
+    fprintf(sim->timeline, "time_ms,event,frame_type,seq,epoch,sub_payload,exec_ms,detail\n");
+  }
+  sim->initialized = true;
+  PrintLog(kMessageType_Pass, "Success to initialize simulated bridge - rtt: %dus, feedback: %dms, loss: %.1f%%, outage_at: %dms\n",
+          config->rtt_us, config->feedback_ms, config->loss, config->outage_at_ms);
+  return 0;
+}
+
+/**
+ * @brief driver 가 보낸 frame 을 시뮬레이션 bridge 로 전달한다.
+ * @param[in] buf UDP frame
+ * @param[in] len frame 길이
+ * @retval 0: 성공
+ * @retval 음수: 잘못된 frame
+ */
+int SimSendFrame(const uint8_t *buf, size_t len)
+{
+  struct SimStatus *sim = &g_mib.sim;
+  struct ReliableHeader header;
+  struct SimEvent *event;
+  uint64_t now_us = GetTimeUs();
+  char detail[64];
+
+  if (len < sizeof(struct ReliableHeader) || buf[0] != RELIABLE_MAGIC) {
+    return -1;
+  }
+  memcpy(&header, buf, sizeof(struct ReliableHeader));
+  sim->session = header.session;
+  sim->tx_count++;
+  if (sim->start_us == 0) {
+    sim->start_us = now_us;
+    if (sim->config.feedback_ms > 0) {
+      sim->feedback_due_us = now_us + (uint64_t)sim->config.feedback_ms * 1000;
+    }
+  }
+
+  if (header.frame_type == kFrameType_SyncRequest) {
+    struct SyncFormat msg;
+    if (len < sizeof(struct SyncFormat)) {
+      return -1;
+    }
+    memcpy(&msg, buf, sizeof(struct SyncFormat));
+    snprintf(detail, sizeof(detail), "t1=%u", msg.t1);
+    if (LoseSimFrame(now_us)) {
+      WriteTimeline(now_us, "loss", &header, 0, 0, detail);
+      return 0;
+    }
+    WriteTimeline(now_us, "sync", &header, 0, 0, detail);
+
+    msg.header.frame_type = kFrameType_SyncResponse;
+    msg.t2 = (uint32_t)(now_us + sim->config.rtt_us / 2);
+    msg.t3 = msg.t2;
+    event = PushSimEvent(now_us + sim->config.rtt_us, false);
+    if (event != NULL) {
+      memcpy(event->frame, &msg, sizeof(struct SyncFormat));
+      event->frame_len = sizeof(struct SyncFormat);
+    }
+    return 0;
+  }
+
+  size_t offset = sizeof(struct ReliableHeader);
+  uint64_t exec_us = now_us + sim->config.rtt_us / 2;
+  uint64_t timed_us = 0;
+  if (header.frame_type == kFrameType_TimedCommand) {
+    uint32_t exec_time_us;
+    if (len < sizeof(struct TimedCommandHeader)) {
+      return -1;
+    }
+    memcpy(&exec_time_us, buf + sizeof(struct ReliableHeader), sizeof(exec_time_us));
+    timed_us = now_us + (int64_t)(int32_t)(exec_time_us - (uint32_t)now_us);
+    if (timed_us > exec_us) {
+      exec_us = timed_us;
+    }
+    offset = sizeof(struct TimedCommandHeader);
+  }
+  else if (header.frame_type != kFrameType_Command) {
+    return -1;
+  }
+
+  const uint8_t *packet = buf + offset;
+  size_t packet_len = len - offset;
+  /* 적용 이벤트에는 ReliableHeader 를 붙여서 저장한다. */
+  if (packet_len <= 3 || packet_len > SIM_FRAME_MAX_LEN - sizeof(struct ReliableHeader)) {
+    return -1;
+  }
+  uint8_t sub_payload_id = packet[3];
+  const char *label = "tx";
+  if (sim->tx_epoch_us[sub_payload_id] != 0 && sim->tx_seq[sub_payload_id] == header.seq) {
+    label = "duplicate";
+  }
+  else if (sim->tx_epoch_us[sub_payload_id] != 0 && sim->tx_epoch[sub_payload_id] == header.epoch) {
+    /* 같은 epoch 의 새 seq 는 ack 전이면 재전송, ack 후면 link 측정용 keepalive 다. */
+    label = IsReliableStateAcked(sub_payload_id) ? "keepalive" : "retransmit";
+  }
+  else {
+    sim->tx_epoch[sub_payload_id] = header.epoch;
+    sim->tx_epoch_us[sub_payload_id] = now_us;
+  }
+  sim->tx_seq[sub_payload_id] = header.seq;
+  DescribePacket(packet, packet_len, detail, sizeof(detail));
+  if (LoseSimFrame(now_us)) {
+    WriteTimeline(now_us, "loss", &header, sub_payload_id, timed_us, detail);
+    return 0;
+  }
+  WriteTimeline(now_us, label, &header, sub_payload_id, timed_us, detail);
+
+  /* ack */
+  event = PushSimEvent(now_us + sim->config.rtt_us, false);
+  if (event != NULL) {
+    struct ReliableAckFormat ack;
+    ack.header = header;
+    ack.header.frame_type = kFrameType_Ack;
+    ack.sub_payload_id = sub_payload_id;
+    memcpy(event->frame, &ack, sizeof(struct ReliableAckFormat));
+    event->frame_len = sizeof(struct ReliableAckFormat);
+    event->sub_payload_id = sub_payload_id;
+  }
+
+  /* 재전송 또는 이전 상태는 bridge 가 버린다. */
+  if (sim->sent[sub_payload_id] && IsNewerEpoch(header.epoch, sim->sent_epoch[sub_payload_id]) == false) {
+    return 0;
+  }
+  sim->sent[sub_payload_id] = true;
+  sim->sent_epoch[sub_payload_id] = header.epoch;
+
+  /* 새 속도 명령이 처음 전송된 뒤 bridge 에 도착하기까지 걸린 시간 (손실된 전송의 재전송 포함) */
+  if (sub_payload_id == BASE_CONTROL_ID) {
+    int delivery_us = (int)(now_us - sim->tx_epoch_us[sub_payload_id]);
+    sim->delivery_count++;
+    if (delivery_us <= sim->config.rtt_us) {
+      sim->delivery_rtt_count++;
+    }
+    if (delivery_us > sim->delivery_max_us) {
+      sim->delivery_max_us = delivery_us;
+    }
+  }
+
+  event = PushSimEvent(exec_us, true);
+  if (event != NULL) {
+    event->sub_payload_id = sub_payload_id;
+    event->epoch = header.epoch;
+    memcpy(event->frame, buf, sizeof(struct ReliableHeader));
+    memcpy(event->frame + sizeof(struct ReliableHeader), packet, packet_len);
+    event->frame_len = sizeof(struct ReliableHeader) + packet_len;
+  }
+  return 0;
+}
+
+/**
+ * @brief KOBUKI feedback 패킷을 담은 feedback frame 을 만든다.
+ * @param[out] frame frame 버퍼 (SIM_FRAME_MAX_LEN)
+ * @param[in] payload feedback sub-payload 들
+ * @param[in] payload_len sub-payload 길이
+ * @return frame 길이
+ */
+static size_t BuildSimFeedback(uint8_t *frame, const uint8_t *payload, size_t payload_len)
+{
+  struct SimStatus *sim = &g_mib.sim;
+  struct ReliableHeader header;
+
+  memset(&header, 0x00, sizeof(header));
+  header.magic = RELIABLE_MAGIC;
+  header.frame_type = kFrameType_Feedback;
+  header.session = sim->session;
+  header.seq = sim->next_seq++;
+
+  uint8_t *ptr = frame;
+  memcpy(ptr, &header, sizeof(header));
+  ptr += sizeof(header);
+  uint8_t *kobuki_packet = ptr;
+  *ptr++ = HEADER_0;
+  *ptr++ = HEADER_1;
+  *ptr++ = (uint8_t)payload_len;
+  memcpy(ptr, payload, payload_len);
+  ptr += payload_len;
+  *ptr = KOBUKI_Checksum(kobuki_packet, ptr - kobuki_packet);
+  return ptr - frame + 1;
+}
+
+/**
+ * @brief 적용 중인 speed, radius 로 시뮬레이션 KOBUKI 를 now_us 까지 움직인다.
+ * @details radius 1 (-1) 은 제자리 회전, 0 은 직진이다.
+ */
+static void MoveSimBase(uint64_t now_us)
+{
+  struct SimStatus *sim = &g_mib.sim;
+  double half_mm = PROFILE_WHEEL_BASE_DEFAULT_MM / 2;
+  double left, right;
+
+  if (now_us <= sim->move_us) {
+    return;
+  }
+  double dt = (double)(now_us - sim->move_us) / 1000000;
+  sim->move_us = now_us;
+
+  if (sim->radius == 0) {
+    left = sim->speed;
+    right = sim->speed;
+  }
+  else if (abs(sim->radius) == 1) {
+    left = -sim->speed;
+    right = sim->speed;
+  }
+  else {
+    left = sim->speed * (sim->radius - half_mm) / sim->radius;
+    right = sim->speed * (sim->radius + half_mm) / sim->radius;
+  }
+  sim->left_mm += left * dt;
+  sim->right_mm += right * dt;
+  sim->theta_rad += (right - left) / PROFILE_WHEEL_BASE_DEFAULT_MM * dt;
+}
+
+/**
+ * @brief 시각에 중앙 bumper 가 눌려 있는지 확인한다.
+ * @details bumper_every_ms 가 있으면 bumper_at_ms 부터 주기마다 bumper_for_ms 동안 누른다.
+ */
+static bool IsSimBumperPressed(uint64_t time_us)
+{
+  struct SimStatus *sim = &g_mib.sim;
+  const struct SimConfig *config = &sim->config;
+
+  if (config->bumper_at_ms < 0 || IsInSimWindow(time_us, config->bumper_at_ms, 0) == false) {
+    return false;
+  }
+  uint64_t pressed_ms = (time_us - sim->start_us) / 1000 - (uint64_t)config->bumper_at_ms;
+  if (config->bumper_every_ms > 0) {
+    pressed_ms %= (uint64_t)config->bumper_every_ms;
+  }
+  return pressed_ms < (uint64_t)config->bumper_for_ms;
+}
+
+/**
+ * @brief 시뮬레이션 KOBUKI 의 basic sensor, inertial sensor feedback frame 을 만든다.
+ * @param[out] frame frame 버퍼 (SIM_FRAME_MAX_LEN)
+ * @param[in] now_us feedback 시각
+ * @return frame 길이
+ */
+static size_t BuildSimSensorFeedback(uint8_t *frame, uint64_t now_us)
+{
+  struct SimStatus *sim = &g_mib.sim;
+  uint8_t payload[2 + sizeof(struct BasicSensorFormat) + 2 + sizeof(struct InertialSensorFormat)];
+  struct BasicSensorFormat basic_sensor;
+  struct InertialSensorFormat inertial_sensor;
+
+  MoveSimBase(now_us);
+  memset(&basic_sensor, 0x00, sizeof(basic_sensor));
+  basic_sensor.timestamp = (uint16_t)((now_us - sim->start_us) / 1000);
+  basic_sensor.left_encoder = (uint16_t)(int64_t)lround(sim->left_mm / PROFILE_TICK_DEFAULT_MM);
+  basic_sensor.right_encoder = (uint16_t)(int64_t)lround(sim->right_mm / PROFILE_TICK_DEFAULT_MM);
+  basic_sensor.battery = 160;
+  basic_sensor.bumper = IsSimBumperPressed(now_us) ? 0x02 : 0x00;
+
+  /* gyro 는 -180 ~ 180 degree 로 wrap 된다. */
+  long angle = lround(sim->theta_rad * 18000 / M_PI) % 36000;
+  if (angle >= 18000) {
+    angle -= 36000;
+  }
+  else if (angle < -18000) {
+    angle += 36000;
+  }
+  memset(&inertial_sensor, 0x00, sizeof(inertial_sensor));
+  inertial_sensor.angle = (int16_t)angle;
+
+  uint8_t *ptr = payload;
+  *ptr++ = FEEDBACK_BASIC_SENSOR_ID;
+  *ptr++ = FEEDBACK_BASIC_SENSOR_LEN;
+  memcpy(ptr, &basic_sensor, sizeof(basic_sensor));
+  ptr += sizeof(basic_sensor);
+  *ptr++ = FEEDBACK_INERTIAL_SENSOR_ID;
+  *ptr++ = FEEDBACK_INERTIAL_SENSOR_LEN;
+  memcpy(ptr, &inertial_sensor, sizeof(inertial_sensor));
+  ptr += sizeof(inertial_sensor);
+  return BuildSimFeedback(frame, payload, ptr - payload);
+}
+
+/**
+ * @brief bridge 가 KOBUKI 패킷을 적용한다. 적용 시각에 더 새로운 상태가 적용되어 있으면 버린다.
+ * @param[in] event 적용할 event
+ */
+static void ApplySimEvent(const struct SimEvent *event)
+{
+  struct SimStatus *sim = &g_mib.sim;
+  const struct ReliableHeader *header = (const struct ReliableHeader *)event->frame;
+  const uint8_t *packet = event->frame + sizeof(struct ReliableHeader);
+  size_t packet_len = event->frame_len - sizeof(struct ReliableHeader);
+  uint8_t id = event->sub_payload_id;
+  char detail[64];
+
+  DescribePacket(packet, packet_len, detail, sizeof(detail));
+  if (sim->applied[id] && IsNewerEpoch(event->epoch, sim->applied_epoch[id]) == false) {
+    sim->drop_count++;
+    WriteTimeline(event->due_us, "drop", header, id, 0, detail);
+    return;
+  }
+  sim->applied[id] = true;
+  sim->applied_epoch[id] = event->epoch;
+  sim->apply_count++;
+  WriteTimeline(event->due_us, "apply", header, id, 0, detail);
+
+  /* 적용 시각부터 새 speed, radius 로 움직인다. */
+  if (id == BASE_CONTROL_ID && packet_len >= 9) {
+    int16_t value[2];
+    memcpy(value, packet + 5, sizeof(value));
+    MoveSimBase(event->due_us);
+    sim->speed = value[0];
+    sim->radius = value[1];
+  }
+
+  /* request extra 에는 KOBUKI 버전 feedback 으로 응답한다. */
+  if (id == REQUEST_EXTRA_ID) {
+    static const uint8_t version_payload[] = {
+      FEEDBACK_HARDWARE_VERSION_ID, FEEDBACK_VERSION_LEN, 0x00, 0x00, 0x01, 0x00,
+      FEEDBACK_FIRMWARE_VERSION_ID, FEEDBACK_VERSION_LEN, 0x05, 0x02, 0x01, 0x00,
+    };
+    struct SimEvent *feedback = PushSimEvent(event->due_us + sim->config.rtt_us / 2, false);
+    if (feedback == NULL) {
+      return;
+    }
+    feedback->frame_len = BuildSimFeedback(feedback->frame, version_payload, sizeof(version_payload));
+  }
+}
+
+/**
+ * @brief 현재 시각까지 도착한 frame 을 꺼낸다. 그 사이의 bridge 적용 event 와 sensor feedback 도 처리한다.
+ * @param[out] buf 수신 버퍼
+ * @param[in] buf_size 수신 버퍼 길이
+ * @retval 양수: frame 길이
+ * @retval 0: 도착한 frame 없음
+ */
+int SimRecvFrame(uint8_t *buf, size_t buf_size)
+{
+  struct SimStatus *sim = &g_mib.sim;
+  uint64_t now_us = GetTimeUs();
+
+  while (true) {
+    int next = FindNextSimEvent();
+    uint64_t due_us = (next >= 0) ? sim->queue[next].due_us : UINT64_MAX;
+    if (sim->feedback_due_us != 0 && sim->feedback_due_us <= due_us && sim->feedback_due_us <= now_us) {
+      uint8_t frame[SIM_FRAME_MAX_LEN];
+      uint64_t feedback_us = sim->feedback_due_us;
+      size_t frame_len = BuildSimSensorFeedback(frame, feedback_us);
+      sim->feedback_due_us += (uint64_t)sim->config.feedback_ms * 1000;
+      if (LoseSimFrame(feedback_us) || frame_len > buf_size) {
+        continue;
+      }
+      memcpy(buf, frame, frame_len);
+      return (int)frame_len;
+    }
+    if (next < 0 || due_us > now_us) {
+      return 0;
+    }
+
+    struct SimEvent event = sim->queue[next];
+    memmove(&sim->queue[next], &sim->queue[next + 1], (sim->queue_size - next - 1) * sizeof(struct SimEvent));
+    sim->queue_size--;
+
+    if (event.apply) {
+      ApplySimEvent(&event);
+      continue;
+    }
+    if (LoseSimFrame(event.due_us)) {
+      WriteTimeline(event.due_us, "loss", (const struct ReliableHeader *)event.frame, event.sub_payload_id, 0, "");
+      continue;
+    }
+    if (event.frame_len > buf_size) {
+      continue;
+    }
+    memcpy(buf, event.frame, event.frame_len);
+    return (int)event.frame_len;
+  }
+}
+
+/**
+ * @brief 다음 시뮬레이션 event 시각
+ * @return us 단위 시각, event 가 없으면 UINT64_MAX
+ */
+uint64_t SimNextDueUs(void)
+{
+  struct SimStatus *sim = &g_mib.sim;
+  int next = FindNextSimEvent();
+  uint64_t due_us = (next < 0) ? UINT64_MAX : sim->queue[next].due_us;
+
+  if (sim->feedback_due_us != 0 && sim->feedback_due_us < due_us) {
+    due_us = sim->feedback_due_us;
+  }
+  return due_us;
+}
+
+/**
+ * @brief 시뮬레이션 결과를 출력하고 timeline 파일을 닫는다.
+ */
+void CloseSim(void)
+{
+  struct SimStatus *sim = &g_mib.sim;
+
+  PrintLog(kMessageType_Pass, "Success to run virtual clock - script: %dms, wall: %dus, tx: %u, apply: %u, drop: %u\n",
+          (int)((GetTimeUs() - g_mib.start_us) / 1000), (int)(GetMonotonicTimeUs() - sim->wall_start_us),
+          sim->tx_count, sim->apply_count, sim->drop_count);
+  PrintLog(kMessageType_Info, "Simulated link status - loss: %u, delivery: %u, delivery_in_rtt: %u, delivery_max: %dus\n",
+          sim->loss_count, sim->delivery_count, sim->delivery_rtt_count, sim->delivery_max_us);
+  if (sim->timeline != NULL) {
+    fclose(sim->timeline);
+    sim->timeline = NULL;
+  }
+  sim->initialized = false;
+}
@@ -0,0 +1,156 @@
+#include "kobuki.h"
+
+/**
+ * @brief Initialize host-bridge clock synchronisation
+ * @param[out] sync 동기화 상태
+ * @param[in] lead_ms 명령 실행 시각 여유 시간, 0: 시각 지정 명령 사용 안함
+ */
+void InitSync(struct SyncStatus *sync, int lead_ms)
+{
+  memset(sync, 0x00, sizeof(struct SyncStatus));
+  sync->lead_ms = lead_ms;
+  sync->next_request_us = GetTimeUs();
+}
+
+/**
+ * @brief 동기화 요청 전송
+ * @param[in] now_us 현재 시각
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ */
+static int SendSyncRequest(uint64_t now_us)
+{
+  struct SyncFormat msg;
+
+  memset(&msg, 0x00, sizeof(struct SyncFormat));
+  msg.header.magic = RELIABLE_MAGIC;
+  msg.header.frame_type = kFrameType_SyncRequest;
+  msg.header.session = g_mib.reliable.session;
+  msg.header.seq = g_mib.reliable.next_seq++;
+  msg.t1 = (uint32_t)now_us;
+
+  return SendUDPMessage(g_mib.socket, g_mib.server_addr, (char *)&msg, sizeof(struct SyncFormat));
+}
+
+/**
+ * @brief bridge 의 동기화 응답으로 offset, RTT 를 갱신한다.
+ * @param[in] buf 수신한 응답 frame
+ * @param[in] len 응답 frame 길이
+ * @param[in] now_us 수신 시각
+ * @retval 0: 성공
+ * @retval 음수: 잘못된 응답
+ * @details offset = ((t2 - t1) + (t3 - t4)) / 2 = (t2 - t1) - rtt / 2
+ *          시계 기준점이 달라 modulo 2^32 로 계산하고, 최근 sample 중 RTT 가 가장 작은 것을 사용한다.
+ */
+int HandleSyncResponse(const uint8_t *buf, size_t len, uint64_t now_us)
+{
+  struct SyncStatus *sync = &g_mib.sync;
+  const struct SyncFormat *msg = (const struct SyncFormat *)buf;
+
+  if (len < sizeof(struct SyncFormat) || msg->header.session != g_mib.reliable.session) {
+    return -1;
+  }
+
+  uint32_t t4 = (uint32_t)now_us;
+  int64_t rtt = (int64_t)(int32_t)(t4 - msg->t1) - (int64_t)(int32_t)(msg->t3 - msg->t2);
+  if (rtt < 0 || rtt > (int64_t)SYNC_INTERVAL_MS * 1000) {
+    return -1;
+  }
+  int rtt_us = (int)rtt;
+
+  struct SyncSample *sample = &sync->samples[sync->sample_index];
+  sample->rtt_us = rtt_us;
+  sample->offset_us = (msg->t2 - msg->t1) - (uint32_t)(rtt_us / 2);
+  sync->sample_index = (sync->sample_index + 1) % SYNC_SAMPLE_MAX;
+  if (sync->samples_size < SYNC_SAMPLE_MAX) {
+    sync->samples_size++;
+  }
+  sync->response_count++;
+
+  struct SyncSample *best = &sync->samples[0];
+  for (int i = 1; i < sync->samples_size; i++) {
+    if (sync->samples[i].rtt_us < best->rtt_us) {
+      best = &sync->samples[i];
+    }
+  }
+  sync->offset_us = best->offset_us;
+  sync->rtt_us = best->rtt_us;
+  sync->valid = true;
+  return 0;
+}
+
+/**
+ * @brief 주기적으로 동기화 요청을 보낸다. 시작 직후에는 SYNC_BURST_COUNT 만큼 빠르게 보낸다.
+ * @param[in] now_us 현재 시각
+ * @return 다음 요청까지 남은 시간 ms 단위, 동기화를 사용하지 않으면 -1
+ */
+int ServiceSync(uint64_t now_us)
+{
+  struct SyncStatus *sync = &g_mib.sync;
+
+  if (sync->lead_ms <= 0) {
+    return -1;
+  }
+  if (now_us >= sync->next_request_us) {
+    SendSyncRequest(now_us);
+    sync->requests_size++;
+    if (sync->requests_size < SYNC_BURST_COUNT) {
+      sync->next_request_us = now_us + SYNC_BURST_INTERVAL_MS * 1000;
+    }
+    else {
+      sync->next_request_us = now_us + SYNC_INTERVAL_MS * 1000;
+    }
+  }
+  return (int)((sync->next_request_us - now_us + 999) / 1000);
+}
+
+/**
+ * @brief driver 시각을 bridge 시각으로 변환한다.
+ * @param[in] local_us driver 시각
+ * @param[out] bridge_us bridge 시각
+ * @retval true: 성공
+ * @retval false: 동기화 되지 않음
+ */
+bool GetBridgeTime(uint64_t local_us, uint32_t *bridge_us)
+{
+  if (g_mib.sync.valid == false) {
+    return false;
+  }
+  *bridge_us = (uint32_t)local_us + g_mib.sync.offset_us;
+  return true;
+}
+
+/**
+ * @brief 명령 전송 시각과 실행 시각의 차이
+ * @return us 단위, 동기화 되지 않았거나 사용하지 않으면 0
+ */
+uint64_t GetSyncLeadUs(void)
+{
+  if (g_mib.sync.valid == false) {
+    return 0;
+  }
+  return (uint64_t)g_mib.sync.lead_ms * 1000;
+}
+
+/**
+ * @brief 이후 KOBUKI_Control* 명령의 실행 시각을 지정한다.
+ * @param[in] local_us driver 시각, 0: 즉시 실행
+ */
+void SetCommandTime(uint64_t local_us)
+{
+  if (GetSyncLeadUs() == 0) {
+    local_us = 0;
+  }
+  g_mib.command_time_us = local_us;
+}
+
+/**
+ * @brief 동기화 상태 출력
+ */
+void PrintSyncStatus(void)
+{
+  struct SyncStatus *sync = &g_mib.sync;
+
+  PrintLog(kMessageType_Info, "Sync status - valid: %d, offset: %uus, rtt: %dus, lead: %dms, request: %d, response: %u\n",
+          sync->valid, sync->offset_us, sync->rtt_us, sync->lead_ms, sync->requests_size, sync->response_count);
+}
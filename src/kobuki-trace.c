@@ -0,0 +1,128 @@
+#include <pthread.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+#include "kobuki.h"
+
+bool g_trace_enabled;
+static uint64_t g_trace_start_ns;
+static pthread_mutex_t g_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct TraceBuffer *g_trace_buffers; ///< 모든 thread 의 buffer
+static __thread struct TraceBuffer *t_trace_buffer; ///< 현재 thread 의 buffer
+
+/**
+ * @brief trace 시각 (CLOCK_MONOTONIC, 가상 시계와 무관)
+ * @return ns 단위 시각
+ */
+uint64_t GetTraceTimeNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief 현재 thread 의 buffer, 처음 호출되면 할당해서 등록한다.
+ * @return buffer, 할당 실패 시 NULL
+ */
+static struct TraceBuffer *GetTraceBuffer(void)
+{
+  if (t_trace_buffer != NULL) {
+    return t_trace_buffer;
+  }
+
+  struct TraceBuffer *buffer = calloc(1, sizeof(struct TraceBuffer));
+  if (buffer == NULL) {
+    return NULL;
+  }
+  buffer->tid = (int)syscall(SYS_gettid);
+
+  pthread_mutex_lock(&g_trace_mutex);
+  buffer->next = g_trace_buffers;
+  g_trace_buffers = buffer;
+  pthread_mutex_unlock(&g_trace_mutex);
+
+  t_trace_buffer = buffer;
+  return buffer;
+}
+
+/**
+ * @brief 런타임 tracing 시작
+ */
+void StartTrace(void)
+{
+  g_trace_start_ns = GetTraceTimeNs();
+  g_trace_enabled = true;
+}
+
+/**
+ * @brief span 하나를 현재 thread 의 buffer 에 기록한다. TRACE_END() 에서 호출된다.
+ * @param[in] name span 이름 (문자열 상수)
+ * @param[in] command_id 명령 ID, 0: 명령과 무관
+ * @param[in] begin_ns 시작 시각
+ * @param[in] end_ns 종료 시각
+ */
+void TraceSpan(const char *name, uint32_t command_id, uint64_t begin_ns, uint64_t end_ns)
+{
+  struct TraceBuffer *buffer = GetTraceBuffer();
+
+  if (buffer == NULL) {
+    return;
+  }
+  if (buffer->events_size >= TRACE_BUFFER_EVENTS) {
+    buffer->dropped_count++;
+    return;
+  }
+  struct TraceEvent *event = &buffer->events[buffer->events_size++];
+  event->name = name;
+  event->command_id = command_id;
+  event->begin_ns = begin_ns;
+  event->duration_ns = end_ns - begin_ns;
+}
+
+/**
+ * @brief 기록한 span 을 Chrome trace (JSON) 파일로 쓴다. Perfetto, chrome://tracing 에서 열 수 있다.
+ * @param[in] trace_file trace 파일 이름
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ * @details 다른 thread 가 기록하지 않을 때 호출한다.
+ */
+int WriteTrace(const char *trace_file)
+{
+  if (g_trace_enabled == false) {
+    return 0;
+  }
+  g_trace_enabled = false;
+
+  FILE *fp = fopen(trace_file, "w");
+  if (fp == NULL) {
+    PrintLog(kMessageType_Error, "Fail to open trace file - %s\n", trace_file);
+    return -1;
+  }
+
+  int pid = (int)getpid();
+  uint32_t events_count = 0;
+  uint32_t dropped_count = 0;
+  bool first = true;
+  fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+  pthread_mutex_lock(&g_trace_mutex);
+  for (struct TraceBuffer *buffer = g_trace_buffers; buffer != NULL; buffer = buffer->next) {
+    for (uint32_t i = 0; i < buffer->events_size; i++) {
+      struct TraceEvent *event = &buffer->events[i];
+      fprintf(fp, "%s\n{\"name\": \"%s\", \"cat\": \"kobuki\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+              "\"pid\": %d, \"tid\": %d, \"args\": {\"cmd_id\": %u}}",
+              first ? "" : ",", event->name, (double)(int64_t)(event->begin_ns - g_trace_start_ns) / 1000,
+              (double)event->duration_ns / 1000, pid, buffer->tid, event->command_id);
+      first = false;
+    }
+    events_count += buffer->events_size;
+    dropped_count += buffer->dropped_count;
+  }
+  pthread_mutex_unlock(&g_trace_mutex);
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+
+  PrintLog(kMessageType_Pass, "Success to write trace file - %s, events: %u, dropped: %u\n", trace_file, events_count, dropped_count);
+  return 0;
+}
@@ -1,51 +1,87 @@
-#include "kobuki.h"
-
-/**
- * @brief Initialize UDP socket
- * @param[in] ip_addr 서버 IPv4 주소
- * @param[in] port_num 서버 포트 번호
- * @param[out] server_addr 서버 주소 정보 구조체
- * @param[out] socket 서버 소켓 정보
- * @retval 0: 성공
- * @retval 음수: 실패
- */
-int InitUDP(const char *ip_addr, const int port_num, struct sockaddr_in *server_addr, int *m_socket)
-{
-  *m_socket = socket(PF_INET, SOCK_DGRAM, 0);
-  if (*m_socket < 0) {
-    PrintLog(kMessageType_Error, "Fail to create socket - socket: %d\n", *m_socket);
-    return -1;
-  }
-
-  memset(server_addr, 0x00, sizeof(struct sockaddr_in));
-  server_addr->sin_family = AF_INET;
-  server_addr->sin_addr.s_addr = inet_addr(ip_addr);
-  server_addr->sin_port = htons(port_num);
-
-  PrintLog(kMessageType_Pass, "Success to create socket\n");
-  return 0;
-}
-
-/**
- * @brief Send UDP message
- * @param[in] m_socket 서버 소켓 정보
- * @param[in] server_addr 서버 주소 정보 구조체
- * @param[in] payload 전송할 메시지
- * @param[in] payload_size 전송할 메시지 길이
- * @retval 0: 성공
- * @retval 음수: 실패
- */
-int SendUDPMessage(int m_socket, struct sockaddr_in server_addr, char *payload, size_t payload_size)
-{
-  int ret;
-
-  ret = sendto(m_socket, payload, payload_size, 0, (struct sockaddr *)&server_addr, sizeof(server_addr));
-  if (ret < 0) {
-    PrintLog(kMessageType_Error, "Fail to send UDP message - ret: %d\n", ret);
-    perror("sendto fail");
-    return -1;
-  }
-
-  PrintLog(kMessageType_Pass, "Success to send UDP message\n");
-  return 0;
-}
\ No newline at end of file
+#include "kobuki.h"
+
+/**
+ * @brief Initialize UDP socket
+ * @param[in] ip_addr 서버 IPv4 주소
+ * @param[in] port_num 서버 포트 번호
+ * @param[out] server_addr 서버 주소 정보 구조체
+ * @param[out] socket 서버 소켓 정보
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ */
+int InitUDP(const char *ip_addr, const int port_num, struct sockaddr_in *server_addr, int *m_socket)
+{
+  *m_socket = socket(PF_INET, SOCK_DGRAM, 0);
+  if (*m_socket < 0) {
+    PrintLog(kMessageType_Error, "Fail to create socket - socket: %d\n", *m_socket);
+    return -1;
+  }
+
+  memset(server_addr, 0x00, sizeof(struct sockaddr_in));
+  server_addr->sin_family = AF_INET;
+  server_addr->sin_addr.s_addr = inet_addr(ip_addr);
+  server_addr->sin_port = htons(port_num);
+
+  PrintLog(kMessageType_Pass, "Success to create socket\n");
+  return 0;
+}
+
+/**
+ * @brief Send UDP message
+ * @param[in] m_socket 서버 소켓 정보, SIM_SOCKET: 시뮬레이션 bridge
+ * @param[in] server_addr 서버 주소 정보 구조체
+ * @param[in] payload 전송할 메시지
+ * @param[in] payload_size 전송할 메시지 길이
+ * @retval 0: 성공
+ * @retval 음수: 실패
+ */
+int SendUDPMessage(int m_socket, struct sockaddr_in server_addr, char *payload, size_t payload_size)
+{
+  int ret;
+
+  if (m_socket == SIM_SOCKET) {
+    return SimSendFrame((const uint8_t *)payload, payload_size);
+  }
+
+  TRACE_BEGIN(trace_span);
+  ret = sendto(m_socket, payload, payload_size, 0, (struct sockaddr *)&server_addr, sizeof(server_addr));
+  if (ret < 0) {
+    PrintLog(kMessageType_Error, "Fail to send UDP message - ret: %d\n", ret);
+    perror("sendto fail");
+    return -1;
+  }
+
+  PrintLog(kMessageType_Pass, "Success to send UDP message\n");
+  TRACE_END(trace_span, "SendUDPMessage");
+  return 0;
+}
+
+/**
+ * @brief Receive UDP message (non-blocking)
+ * @param[in] m_socket 서버 소켓 정보, SIM_SOCKET: 시뮬레이션 bridge
+ * @param[out] buf 수신 버퍼
+ * @param[in] buf_size 수신 버퍼 길이
+ * @retval 양수: 수신한 메시지 길이
+ * @retval 0: 수신할 메시지 없음
+ * @retval 음수: 실패
+ */
+int RecvUDPMessage(int m_socket, char *buf, size_t buf_size)
+{
+  int ret;
+
+  if (m_socket == SIM_SOCKET) {
+    return SimRecvFrame((uint8_t *)buf, buf_size);
+  }
+
+  ret = recvfrom(m_socket, buf, buf_size, MSG_DONTWAIT, NULL, NULL);
+  if (ret < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return 0;
+    }
+    PrintLog(kMessageType_Error, "Fail to receive UDP message - ret: %d\n", ret);
+    perror("recvfrom fail");
+    return -1;
+  }
+
+  return ret;
+}
@@ -0,0 +1,250 @@
+#include <math.h>
+
+#include "kobuki.h"
+
+/**
+ * @brief waypoint 경로의 점
+ */
+struct WaypointPoint
+{
+  double x_mm;
+  double y_mm;
+  int speed; ///< 이 점까지의 속도 mm/s 단위
+};
+
+/**
+ * @brief 추정 위치를 원점으로 되돌린다. 다음 waypoint 들은 이 위치 기준이다.
+ */
+void ResetOdometry(void)
+{
+  struct OdometryStatus *odometry = &g_mib.odometry;
+
+  odometry->x_mm = 0;
+  odometry->y_mm = 0;
+  odometry->theta_rad = 0;
+}
+
+/**
+ * @brief basic sensor(와 inertial sensor) feedback 으로 위치를 갱신한다.
+ * @param[in] decoded 이번 feedback 에서 decode 한 종류
+ * @param[in] now_us feedback 수신 시각
+ * @details 방향은 gyro 를 쓰고, gyro 가 없으면 바퀴 거리 차이와 profile 의 wheel_base 로 구한다.
+ */
+void UpdateOdometry(FeedbackType decoded, uint64_t now_us)
+{
+  struct OdometryStatus *odometry = &g_mib.odometry;
+  struct BasicSensorFormat *basic_sensor = &g_mib.feedback.basic_sensor;
+  bool gyro = (decoded & kFeedbackType_InertialSensor) != 0;
+  int16_t angle = g_mib.feedback.inertial_sensor.angle;
+
+  if (odometry->valid == false) {
+    odometry->left_encoder = basic_sensor->left_encoder;
+    odometry->right_encoder = basic_sensor->right_encoder;
+    odometry->angle = angle;
+    odometry->update_us = now_us;
+    odometry->valid = true;
+    return;
+  }
+
+  /* encoder 는 16bit 로 wrap, gyro 는 -180 ~ 180 degree 로 wrap 된다. */
+  double left_mm = (int16_t)(basic_sensor->left_encoder - odometry->left_encoder) * g_mib.profile.tick_mm;
+  double right_mm = (int16_t)(basic_sensor->right_encoder - odometry->right_encoder) * g_mib.profile.tick_mm;
+  double theta_diff;
+  if (gyro) {
+    int angle_diff = angle - odometry->angle;
+    if (angle_diff > 18000) {
+      angle_diff -= 36000;
+    }
+    else if (angle_diff < -18000) {
+      angle_diff += 36000;
+    }
+    theta_diff = angle_diff * M_PI / 18000;
+    odometry->angle = angle;
+  }
+  else {
+    theta_diff = (g_mib.profile.wheel_base_mm > 0) ? (right_mm - left_mm) / g_mib.profile.wheel_base_mm : 0;
+  }
+
+  double distance_mm = (left_mm + right_mm) / 2;
+  double heading = odometry->theta_rad + theta_diff / 2;
+  odometry->x_mm += distance_mm * cos(heading);
+  odometry->y_mm += distance_mm * sin(heading);
+  odometry->theta_rad += theta_diff;
+  odometry->left_mm += left_mm;
+  odometry->right_mm += right_mm;
+  odometry->left_encoder = basic_sensor->left_encoder;
+  odometry->right_encoder = basic_sensor->right_encoder;
+  odometry->update_us = now_us;
+  odometry->update_count++;
+}
+
+/**
+ * @brief 현재 위치에서 경로를 따라 lookahead 만큼 앞의 목표점을 찾는다.
+ * @param[in] path 경로 (path[0]: 시작 위치)
+ * @param[in] last 마지막 점 index
+ * @param[in,out] segment 현재 구간 (path[segment - 1] -> path[segment]), 지나간 구간은 넘긴다.
+ * @param[out] carrot_x 목표점
+ * @param[out] carrot_y 목표점
+ * @return 마지막 waypoint 까지 남은 경로 거리 mm 단위
+ */
+static double FindWaypointCarrot(const struct WaypointPoint *path, int last, int *segment, double *carrot_x, double *carrot_y)
+{
+  struct OdometryStatus *odometry = &g_mib.odometry;
+  double t;
+  double ax, ay, vx, vy;
+
+  while (true) {
+    ax = path[*segment - 1].x_mm;
+    ay = path[*segment - 1].y_mm;
+    vx = path[*segment].x_mm - ax;
+    vy = path[*segment].y_mm - ay;
+    double len2 = vx * vx + vy * vy;
+    t = (len2 > 0) ? ((odometry->x_mm - ax) * vx + (odometry->y_mm - ay) * vy) / len2 : 1;
+    double reach_mm = hypot(path[*segment].x_mm - odometry->x_mm, path[*segment].y_mm - odometry->y_mm);
+    if (*segment < last && (t >= 1 || reach_mm < WAYPOINT_REACH_MM)) {
+      PrintLog(kMessageType_Info, "Pass waypoint #%d - x: %.0fmm, y: %.0fmm, error: %.0fmm\n",
+              *segment, path[*segment].x_mm, path[*segment].y_mm, reach_mm);
+      (*segment)++;
+      continue;
+    }
+    break;
+  }
+
+  /* 구간 위의 가장 가까운 점에서 경로를 따라 lookahead 만큼 이동한다. */
+  t = (t < 0) ? 0 : (t > 1) ? 1 : t;
+  double x = ax + t * vx;
+  double y = ay + t * vy;
+  double lookahead_mm = WAYPOINT_LOOKAHEAD_MM;
+  double remaining_mm = 0;
+  bool found = false;
+  *carrot_x = path[last].x_mm;
+  *carrot_y = path[last].y_mm;
+  for (int i = *segment; i <= last; i++) {
+    double length_mm = hypot(path[i].x_mm - x, path[i].y_mm - y);
+    if (found == false && length_mm >= lookahead_mm) {
+      *carrot_x = x + (path[i].x_mm - x) * lookahead_mm / length_mm;
+      *carrot_y = y + (path[i].y_mm - y) * lookahead_mm / length_mm;
+      found = true;
+    }
+    lookahead_mm -= length_mm;
+    remaining_mm += length_mm;
+    x = path[i].x_mm;
+    y = path[i].y_mm;
+  }
+  return remaining_mm;
+}
+
+/**
+ * @brief 연속된 waypoint 를 pure pursuit 로 따라간다. feedback 마다 속도, 반경을 다시 계산해서 전송한다.
+ * @param[in] lines waypoint 명령들
+ * @param[in] lines_size waypoint 개수
+ * @return 중단시킨 이벤트 (kEventType_Reflex, kEventType_Terminate, --reload stop 이면 kEventType_Reload),
+ *         마지막 waypoint 에 도착하면 0
+ * @retval 음수: 실패 (feedback 없음)
+ * @details 중간 waypoint 에서 멈추지 않고, 마지막 waypoint 에서만 감속해서 정지한다.
+ *          정지 상태에서 목표점이 크게 벗어나 있으면 제자리 회전으로 방향을 맞춘다.
+ */
+int FollowWaypoints(const struct ScriptLine *lines, int lines_size)
+{
+  struct OdometryStatus *odometry = &g_mib.odometry;
+  struct WaypointPoint path[SCRIPT_COMMAND_MAX_LEN + 1];
+  const EventType stop_mask = kEventType_Reflex | kEventType_Terminate |
+                              ((g_mib.reload_mode == kReloadMode_Stop) ? kEventType_Reload : kEventType_None);
+  const EventType wake_mask = kEventType_Feedback | stop_mask;
+
+  if (lines_size <= 0 || lines_size > SCRIPT_COMMAND_MAX_LEN) {
+    return -1;
+  }
+  path[0].x_mm = odometry->x_mm;
+  path[0].y_mm = odometry->y_mm;
+  path[0].speed = 0;
+  for (int i = 0; i < lines_size; i++) {
+    path[i + 1].x_mm = lines[i].x;
+    path[i + 1].y_mm = lines[i].y;
+    path[i + 1].speed = lines[i].speed;
+  }
+
+  PrintLog(kMessageType_Info, "Start to follow waypoints - count: %d, pose: (%.0fmm, %.0fmm, %.1fdeg)\n",
+          lines_size, odometry->x_mm, odometry->y_mm, odometry->theta_rad * 180 / M_PI);
+  SetCommandTime(0);
+  g_mib.events &= ~kEventType_Feedback;
+  uint64_t start_us = GetTimeUs();
+  uint32_t update_count = 0;
+  int segment = 1;
+  int last_speed = 0;
+  int last_radius = 0;
+  while (true) {
+    uint64_t timeout_us = ((odometry->valid) ? odometry->update_us : start_us) + WAYPOINT_FEEDBACK_TIMEOUT_MS * 1000;
+    int ret = WaitEventUntil(timeout_us, wake_mask);
+    if (ret < 0 || ret == 0) {
+      KOBUKI_EmergencyStop();
+      PrintLog(kMessageType_Error, "Fail to follow waypoints - no feedback for %dms\n", WAYPOINT_FEEDBACK_TIMEOUT_MS);
+      return -1;
+    }
+    if (ret & stop_mask) {
+      return ret & stop_mask;
+    }
+    if (odometry->valid == false) {
+      continue;
+    }
+
+    TRACE_BEGIN(trace_span);
+    double carrot_x, carrot_y;
+    double remaining_mm = FindWaypointCarrot(path, lines_size, &segment, &carrot_x, &carrot_y);
+    double goal_mm = hypot(path[lines_size].x_mm - odometry->x_mm, path[lines_size].y_mm - odometry->y_mm);
+    if (segment == lines_size && (goal_mm < WAYPOINT_REACH_MM || (remaining_mm < 1 && goal_mm < WAYPOINT_LOOKAHEAD_MM))) {
+      KOBUKI_ControlSpeed(g_mib.device, 0, 0);
+      TRACE_END(trace_span, "waypoint_step");
+      PrintLog(kMessageType_Pass, "Success to follow waypoints - pose: (%.0fmm, %.0fmm, %.1fdeg), error: %.0fmm, time: %dms, updates: %u\n",
+              odometry->x_mm, odometry->y_mm, odometry->theta_rad * 180 / M_PI, goal_mm,
+              (int)((GetTimeUs() - start_us) / 1000), update_count);
+      return 0;
+    }
+
+    /* 목표점을 로봇 좌표계로 바꾼다. */
+    double dx = carrot_x - odometry->x_mm;
+    double dy = carrot_y - odometry->y_mm;
+    double local_x = cos(odometry->theta_rad) * dx + sin(odometry->theta_rad) * dy;
+    double local_y = -sin(odometry->theta_rad) * dx + cos(odometry->theta_rad) * dy;
+    double alpha = atan2(local_y, local_x);
+
+    int speed;
+    int radius;
+    if (fabs(alpha) > WAYPOINT_SPIN_ANGLE_DEG * M_PI / 180) {
+      speed = (alpha > 0) ? WAYPOINT_SPIN_SPEED : -WAYPOINT_SPIN_SPEED;
+      radius = 1;
+    }
+    else {
+      /* 목표점을 지나는 원호: 곡률 = 2 * y / 거리^2 */
+      double curvature = 2 * local_y / (local_x * local_x + local_y * local_y);
+      double speed_max = path[segment].speed;
+      double decel_max = sqrt(2.0 * WAYPOINT_DECEL * remaining_mm);
+      if (decel_max < speed_max) {
+        speed_max = (decel_max > WAYPOINT_SPEED_MIN) ? decel_max : WAYPOINT_SPEED_MIN;
+      }
+      if (fabs(curvature) * WAYPOINT_STRAIGHT_RADIUS_MM < 1) {
+        radius = 0;
+      }
+      else {
+        radius = (int)lround(1 / curvature);
+        if (abs(radius) < 2) {
+          radius = (radius < 0) ? -2 : 2;
+        }
+        double lateral_max = sqrt(WAYPOINT_LATERAL_ACCEL * fabs(1 / curvature));
+        if (lateral_max < speed_max) {
+          speed_max = (lateral_max > WAYPOINT_SPEED_MIN) ? lateral_max : WAYPOINT_SPEED_MIN;
+        }
+      }
+      speed = (int)speed_max;
+    }
+
+    if (speed != last_speed || radius != last_radius) {
+      g_mib.command_id++;
+      KOBUKI_ControlSpeed(g_mib.device, speed, radius);
+      last_speed = speed;
+      last_radius = radius;
+    }
+    update_count++;
+    TRACE_END(trace_span, "waypoint_step");
+  }
+}
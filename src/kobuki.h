@@ -1,166 +1,979 @@
-// C library headers
-#include <stdio.h>
-#include <stdint.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdarg.h>
-#include <signal.h>
-#include <unistd.h>
-#include <stdbool.h>
-#include <netinet/in.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
-#include <netinet/in.h>
-
-// Linux headers
-#include <fcntl.h> // Contains file controls like O_RDWR
-#include <termios.h> // Contains POSIX terminal control definitions
-#include <unistd.h> // write(), read(), close()
-
-#define STR_FAIL            "\x1b[1;31mFAIL\x1b[0m"
-#define STR_ERRO            "\x1b[1;31mERRO\x1b[0m"
-#define STR_PASS            "\x1b[1;32mPASS\x1b[0m"
-#define STR_INFO            "\x1b[0mINFO\x1b[0m"
-#define STR_WARN            "\x1b[1;33mWARN\x1b[0m"
-#define STR_DEBUG           "\x1b[1;35mDBUG\x1b[0m"
-
-/* KOBUKI DFINES */
-#define HEADER_0 0xAA
-#define HEADER_1 0x55
-#define PAYLOAD_LED_LEN 4
-#define PAYLOAD_SPEED_LEN 6
-#define LED_CONTROL_ID 0x0C
-#define LED_CONTROL_LEN 2
-#define BASE_CONTROL_ID 0x01
-#define BASE_CONTROL_LEN 4
-#define SCRIPT_COMMAND_MAX_LEN 100
-
-/* UDP DEFINES */
-#define UDP_PORT_NUM 5555
-#define UDP_PACKET_MAX_SIZE 1024
-
-/**
- * @brief Log message type
- */
-enum eMessageType
-{
-  kMessageType_None = 0,
-  kMessageType_Error = 1,
-  kMessageType_Pass = 2,
-  kMessageType_Info = 3,
-  kMessageType_Debug = 4,
-};
-typedef int MessageType;
-
-/**
- * @brief KOBUKI LED color type
- */
-enum eLEDColor
-{
-  kLEDColor_None = 0,
-  kLEDColor_Green = 1,
-  kLEDColor_Red = 2,
-};
-typedef int LEDColor;
-
-/**
- * @brief KOBUKI command tpye in script file
- * 
- */
-enum eCommandType
-{
-  kCommandType_None = 0,
-  kCommandType_LED = 1,
-  kCommandType_Speed = 2,
-  kCommandType_Sleep = 3,
-};
-typedef int CommandType;
-
-/**
- * @brief KOBUKI LED command message format
- * 
- */
-struct LEDMessageFormat
-{
-  uint8_t header_0;
-  uint8_t header_1;
-  uint8_t payload_len;
-  uint8_t sub_payload_id;
-  uint8_t sub_payload_len;
-  uint16_t led;
-} __attribute__((__packed__));
-
-/**
- * @brief KOBUKI speed command message format
- * 
- */
-struct SpeedMessageFormat
-{
-  uint8_t header_0;
-  uint8_t header_1;
-  uint8_t payload_len;
-  uint8_t sub_payload_id;
-  uint8_t sub_payload_len;
-  uint16_t speed;
-  uint16_t radius;
-} __attribute__((__packed__));
-
-
-/**
- * @brief Command line in script file
- * 
- */
-struct ScriptLine
-{
-  CommandType type;
-  int speed; ///< 이동 속도 mm/s 단위
-  int radius; ///< 회전 반경 mm 단위
-	float radian; ///< 회전 각도
-	int distance; ///< 이동 거리 mm 단위
-	int move_time; ///< 속도, 이동 거리로 이동 시간 계산 ms 단위
-
-  int delay; ///< ms 단위
-  
-  int led_num;
-  int color;
-};
-
-/**
- * @brief Global MIB
- * 
- */
-struct MIB
-{
-  char server_ip_addr[16];
-  int server_port_num;
-
-  int device;
-  struct termios newtio;
-  uint16_t led_status;
-  uint16_t speed_status;
-  uint16_t radius_status;
-
-  char device_name[SCRIPT_COMMAND_MAX_LEN];
-  char baud_rate[SCRIPT_COMMAND_MAX_LEN];
-  int log_level;
-  char script_file_name[SCRIPT_COMMAND_MAX_LEN];
-  int script_lines_size;
-  struct ScriptLine script_lines[SCRIPT_COMMAND_MAX_LEN];
-
-  struct sockaddr_in server_addr;
-  int socket;
-};
-
-extern struct MIB g_mib;
-
-/* kobuki-fun.c */
-void PrintLog(MessageType msg_type, const char *format, ...);
-void PrintHexDump(MessageType msg_Type, CommandType command_type, const char *format, void *command);
-int KOBUKI_ControlLED(int device, int led_num, int color);
-int KOBUKI_ControlSpeed(int device, int speed, int radius);
-int ParseScriptCommand(char *script_file, struct MIB *mib);
-
-/* kobuki-udp.c */
-int InitUDP(const char *ip_addr, const int port_num, struct sockaddr_in *server_addr, int *socket);
-int SendUDPMessage(int m_socket, struct sockaddr_in server_addr, char *payload, size_t payload_size);
\ No newline at end of file
+// C library headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+// Linux headers
+#include <fcntl.h> // Contains file controls like O_RDWR
+#include <termios.h> // Contains POSIX terminal control definitions
+#include <unistd.h> // write(), read(), close()
+#include <poll.h>
+
+#define STR_FAIL            "\x1b[1;31mFAIL\x1b[0m"
+#define STR_ERRO            "\x1b[1;31mERRO\x1b[0m"
+#define STR_PASS            "\x1b[1;32mPASS\x1b[0m"
+#define STR_INFO            "\x1b[0mINFO\x1b[0m"
+#define STR_WARN            "\x1b[1;33mWARN\x1b[0m"
+#define STR_DEBUG           "\x1b[1;35mDBUG\x1b[0m"
+
+/* KOBUKI DFINES */
+#define HEADER_0 0xAA
+#define HEADER_1 0x55
+#define PAYLOAD_LED_LEN 4
+#define PAYLOAD_SPEED_LEN 6
+#define LED_CONTROL_ID 0x0C
+#define LED_CONTROL_LEN 2
+#define BASE_CONTROL_ID 0x01
+#define BASE_CONTROL_LEN 4
+#define REQUEST_EXTRA_ID 0x09
+#define REQUEST_EXTRA_LEN 2
+#define REQUEST_EXTRA_HARDWARE_VERSION 0x01
+#define REQUEST_EXTRA_FIRMWARE_VERSION 0x02
+#define REQUEST_EXTRA_UDID 0x08
+#define SCRIPT_COMMAND_MAX_LEN 100
+#define SCRIPT_VALUE_MAX 1000000000 ///< 거리(mm), 시간(ms) 최대값
+#define CONFIG_LINE_MAX_LEN 128 ///< link policy, profile 파일 한 줄 최대 길이
+
+/* KOBUKI FEEDBACK DEFINES */
+#define FEEDBACK_BASIC_SENSOR_ID 0x01
+#define FEEDBACK_BASIC_SENSOR_LEN 15
+#define FEEDBACK_INERTIAL_SENSOR_ID 0x04
+#define FEEDBACK_INERTIAL_SENSOR_LEN 7
+#define FEEDBACK_HARDWARE_VERSION_ID 0x0A
+#define FEEDBACK_FIRMWARE_VERSION_ID 0x0B
+#define FEEDBACK_VERSION_LEN 4
+
+/* STOP DEFINES */
+#define STOP_RETRY_MAX 3 ///< 종료 시 stop 명령 재전송 횟수
+#define STOP_RETRY_INTERVAL_MS 20
+#define STOP_STILL_FRAMES 2 ///< 종료 시 stop 확인: encoder 가 바뀌지 않은 basic sensor 연속 수신 횟수
+#define STOP_STILL_TIMEOUT_MS 500 ///< 종료 시 encoder 정지 확인 최대 대기 시간
+
+/* REFLEX DEFINES */
+#define REFLEX_DEFAULT_MASK (kReflexType_Bumper | kReflexType_Cliff | kReflexType_WheelDrop)
+#define REFLEX_BACKOFF_TIME_MS 500 ///< back-off 속도로 이동하는 시간
+
+/* READY DEFINES */
+#define READY_TIMEOUT_DEFAULT_MS 3000
+
+/* UDP DEFINES */
+#define UDP_PORT_NUM 5555
+#define UDP_PACKET_MAX_SIZE 1024
+
+/* RELIABLE DEFINES */
+#define RELIABLE_MAGIC 0x4B
+#define RELIABLE_STATE_MAX 4 ///< sub-payload 종류별 최신 상태 슬롯 개수
+#define RELIABLE_FRAME_MAX_LEN 32 ///< 재전송용으로 보관하는 KOBUKI 패킷 최대 길이
+#define RELIABLE_SENT_WINDOW 64 ///< RTT/손실 측정용 송신 기록 개수
+#define RELIABLE_RTO_INIT_MS 50
+#define RELIABLE_RTO_MIN_MS 10 ///< 재전송 최소 간격 (재전송 rate 상한)
+#define RELIABLE_RTO_MAX_MS 200
+#define RELIABLE_FLUSH_TIMEOUT_MS 500
+
+/* LINK DEFINES */
+#define LINK_DEGRADED_LOSS_DEFAULT 0.05f
+#define LINK_POOR_LOSS_DEFAULT 0.20f
+#define LINK_DEGRADED_RTT_DEFAULT_MS 50
+#define LINK_POOR_RTT_DEFAULT_MS 150
+#define LINK_LOST_TIMEOUT_DEFAULT_MS 1000 ///< bridge 로부터 아무 frame 도 받지 못한 시간
+#define LINK_RECOVER_DEFAULT_MS 2000 ///< 더 좋은 상태로 바뀌기 전에 유지되어야 하는 시간
+
+/* PROFILE DEFINES */
+#define PROFILE_WHEEL_BASE_DEFAULT_MM 230.0f ///< 바퀴 간격, 회전 반경에 절반(115)을 더한다
+#define PROFILE_TICK_DEFAULT_MM 0.085292f ///< encoder 1 tick 당 이동 거리
+#define PROFILE_SPIN_RADIUS_DEFAULT_MM 180.0f ///< 제자리 회전 시간 계산 반경
+#define PROFILE_ARC_GAIN_DEFAULT 2.0f ///< 곡선 이동 시간 보정
+
+/* CALIBRATION DEFINES */
+#define CALIB_SPEED 200 ///< 직선, 곡선 측정 속도 mm/s 단위
+#define CALIB_SPIN_SPEED 100 ///< 제자리 회전 측정 속도 mm/s 단위
+#define CALIB_ARC_RADIUS 400 ///< 곡선 측정 반경 mm 단위 (KOBUKI 에 그대로 전송)
+#define CALIB_SHORT_MS 1500
+#define CALIB_LONG_MS 3000
+#define CALIB_TURN_MS 2000
+#define CALIB_SETTLE_MS 800 ///< 정지 후 feedback 이 안정될 때까지 기다리는 시간
+
+/* WAYPOINT DEFINES */
+#define WAYPOINT_SPEED_DEFAULT 250 ///< waypoint 속도를 생략했을 때 mm/s 단위
+#define WAYPOINT_SPEED_MIN 40 ///< 마지막 waypoint 에 접근할 때 최소 속도 mm/s 단위
+#define WAYPOINT_LOOKAHEAD_MM 300 ///< pure pursuit 목표점 거리
+#define WAYPOINT_REACH_MM 50 ///< waypoint 도착 판정 거리
+#define WAYPOINT_DECEL 250 ///< 마지막 waypoint 감속도 mm/s^2 단위
+#define WAYPOINT_LATERAL_ACCEL 400 ///< 곡선 주행 횡가속도 제한 mm/s^2 단위
+#define WAYPOINT_SPIN_ANGLE_DEG 60 ///< 목표점이 이 각도보다 벗어나 있으면 제자리 회전
+#define WAYPOINT_SPIN_SPEED 80 ///< 제자리 회전 바퀴 속도 mm/s 단위
+#define WAYPOINT_STRAIGHT_RADIUS_MM 8000 ///< 이보다 큰 반경은 직진
+#define WAYPOINT_FEEDBACK_TIMEOUT_MS 500 ///< feedback 이 없으면 정지
+
+/* SYNC DEFINES */
+#define SYNC_SAMPLE_MAX 8 ///< offset 추정에 사용하는 최근 sample 개수 (최소 RTT 선택)
+#define SYNC_BURST_COUNT 8 ///< 시작 시 연속 요청 개수
+#define SYNC_BURST_INTERVAL_MS 20
+#define SYNC_INTERVAL_MS 1000
+#define SYNC_LEAD_DEFAULT_MS 50 ///< 명령 전송 후 bridge 에서 실행되기까지의 여유 시간
+
+/* SIM DEFINES */
+#define SIM_SOCKET (-2) ///< 시뮬레이션 bridge 를 가리키는 socket 값 (poll() 에서 무시된다)
+#define SIM_RTT_DEFAULT_US 2000
+#define SIM_QUEUE_MAX 64
+#define SIM_FRAME_MAX_LEN 64
+#define SIM_FEEDBACK_DEFAULT_MS 20 ///< KOBUKI basic sensor feedback 주기 (50Hz)
+#define SIM_SEED_DEFAULT 1
+#define SIM_OUTAGE_FOR_DEFAULT_MS 2000
+#define SIM_BUMPER_FOR_DEFAULT_MS 500
+
+/* TRACE DEFINES */
+#define TRACE_BUFFER_EVENTS 65536 ///< thread 별 최대 span 개수, 넘치면 버린다
+
+/* SHARED MEMORY DEFINES */
+#define SHARED_MAGIC 0x4B4F424B ///< "KOBK"
+#define SHARED_VERSION 2
+#define SHARED_NAME_MAX_LEN 64
+#define SHARED_SERVE_INTERVAL_MS 1000
+#define SHARED_NOTIFY_CHECK_MS 100 ///< helper thread 가 종료 요청을 확인하는 최대 간격
+#define SHARED_LED_1 0x01 ///< SharedCommand.led_mask
+#define SHARED_LED_2 0x02
+
+/**
+ * @brief Log message type
+ */
+enum eMessageType
+{
+  kMessageType_None = 0,
+  kMessageType_Error = 1,
+  kMessageType_Pass = 2,
+  kMessageType_Info = 3,
+  kMessageType_Debug = 4,
+};
+typedef int MessageType;
+
+/**
+ * @brief KOBUKI LED color type
+ */
+enum eLEDColor
+{
+  kLEDColor_None = 0,
+  kLEDColor_Green = 1,
+  kLEDColor_Red = 2,
+};
+typedef int LEDColor;
+
+/**
+ * @brief KOBUKI command tpye in script file
+ * 
+ */
+enum eCommandType
+{
+  kCommandType_None = 0,
+  kCommandType_LED = 1,
+  kCommandType_Speed = 2,
+  kCommandType_Sleep = 3,
+  kCommandType_Waypoint = 4,
+};
+typedef int CommandType;
+
+/**
+ * @brief UDP frame type in reliable header
+ */
+enum eFrameType
+{
+  kFrameType_None = 0,
+  kFrameType_Command = 1, ///< driver -> bridge, KOBUKI 패킷 포함
+  kFrameType_Ack = 2, ///< bridge -> driver
+  kFrameType_TimedCommand = 3, ///< driver -> bridge, 실행 시각 + KOBUKI 패킷 포함
+  kFrameType_SyncRequest = 4, ///< driver -> bridge
+  kFrameType_SyncResponse = 5, ///< bridge -> driver
+  kFrameType_Feedback = 6, ///< bridge -> driver, KOBUKI feedback 패킷 포함
+};
+typedef int FrameType;
+
+/**
+ * @brief Events which wake up WaitEvent()
+ */
+enum eEventType
+{
+  kEventType_None = 0,
+  kEventType_Ack = 1 << 0,
+  kEventType_Sync = 1 << 1,
+  kEventType_Feedback = 1 << 2,
+  kEventType_Terminate = 1 << 3, ///< 종료 시그널, 처리 후에도 지워지지 않는다
+  kEventType_Reflex = 1 << 4, ///< bumper, cliff, wheel drop 으로 stop 전송
+  kEventType_Shared = 1 << 5, ///< 공유 메모리 명령 수신
+  kEventType_Reload = 1 << 6, ///< 새 script 를 읽어서 교체 대기 중
+};
+typedef uint32_t EventType;
+
+/**
+ * @brief Link quality state between the driver and the bridge
+ */
+enum eLinkState
+{
+  kLinkState_Good = 0,
+  kLinkState_Degraded = 1,
+  kLinkState_Poor = 2,
+  kLinkState_Lost = 3, ///< stop 전송, speed 명령은 0 으로 바뀐다
+  kLinkState_Max = 4,
+};
+typedef int LinkState;
+
+/**
+ * @brief When a reloaded script replaces the running one
+ */
+enum eReloadMode
+{
+  kReloadMode_None = 0, ///< script 파일을 감시하지 않음
+  kReloadMode_Segment = 1, ///< 현재 segment 가 끝난 뒤 교체
+  kReloadMode_Stop = 2, ///< 즉시 정지하고 교체
+};
+typedef int ReloadMode;
+
+/**
+ * @brief Clock type of the event loop and the script executor
+ */
+enum eClockType
+{
+  kClockType_Monotonic = 0, ///< CLOCK_MONOTONIC, 실제 시간만큼 대기
+  kClockType_Virtual = 1, ///< 대기 없이 다음 deadline 으로 이동, 시뮬레이션 bridge 사용
+};
+typedef int ClockType;
+
+/**
+ * @brief Clock interface
+ */
+struct ClockOps
+{
+  const char *name;
+  uint64_t (*now_us)(void);
+  int (*poll)(struct pollfd *fds, int fds_size, uint64_t wake_us); ///< wake_us 까지 fd 를 기다린다, poll() 과 같은 반환값
+};
+
+/**
+ * @brief KOBUKI LED command message format
+ * 
+ */
+struct LEDMessageFormat
+{
+  uint8_t header_0;
+  uint8_t header_1;
+  uint8_t payload_len;
+  uint8_t sub_payload_id;
+  uint8_t sub_payload_len;
+  uint16_t led;
+} __attribute__((__packed__));
+
+/**
+ * @brief KOBUKI speed command message format
+ * 
+ */
+struct SpeedMessageFormat
+{
+  uint8_t header_0;
+  uint8_t header_1;
+  uint8_t payload_len;
+  uint8_t sub_payload_id;
+  uint8_t sub_payload_len;
+  uint16_t speed;
+  uint16_t radius;
+} __attribute__((__packed__));
+#define SPEED_FRAME_LEN (sizeof(struct SpeedMessageFormat) + 1) ///< crc 포함
+
+/**
+ * @brief Feedback sub-payloads decoded from one KOBUKI feedback packet
+ */
+enum eFeedbackType
+{
+  kFeedbackType_None = 0,
+  kFeedbackType_BasicSensor = 1 << 0,
+  kFeedbackType_InertialSensor = 1 << 1,
+  kFeedbackType_Version = 1 << 2,
+};
+typedef uint32_t FeedbackType;
+
+/**
+ * @brief Sensors which trigger the safety reflex
+ */
+enum eReflexType
+{
+  kReflexType_None = 0,
+  kReflexType_Bumper = 1 << 0,
+  kReflexType_Cliff = 1 << 1,
+  kReflexType_WheelDrop = 1 << 2,
+};
+typedef uint32_t ReflexType;
+
+/**
+ * @brief KOBUKI request extra command message format
+ */
+struct RequestExtraMessageFormat
+{
+  uint8_t header_0;
+  uint8_t header_1;
+  uint8_t payload_len;
+  uint8_t sub_payload_id;
+  uint8_t sub_payload_len;
+  uint16_t request_flags;
+} __attribute__((__packed__));
+
+/**
+ * @brief KOBUKI basic sensor data (feedback sub-payload 0x01)
+ */
+struct BasicSensorFormat
+{
+  uint16_t timestamp; ///< ms 단위
+  uint8_t bumper; ///< 0x01: right, 0x02: central, 0x04: left
+  uint8_t wheel_drop; ///< 0x01: right, 0x02: left
+  uint8_t cliff; ///< 0x01: right, 0x02: central, 0x04: left
+  uint16_t left_encoder;
+  uint16_t right_encoder;
+  int8_t left_pwm;
+  int8_t right_pwm;
+  uint8_t button;
+  uint8_t charger;
+  uint8_t battery; ///< 0.1V 단위
+  uint8_t overcurrent;
+} __attribute__((__packed__));
+
+/**
+ * @brief KOBUKI inertial sensor data (feedback sub-payload 0x04)
+ */
+struct InertialSensorFormat
+{
+  int16_t angle; ///< 0.01 degree 단위
+  int16_t angle_rate; ///< 0.01 degree/s 단위
+  uint8_t unused[3];
+} __attribute__((__packed__));
+
+/**
+ * @brief Decoded KOBUKI feedback
+ */
+struct FeedbackStatus
+{
+  struct BasicSensorFormat basic_sensor;
+  struct InertialSensorFormat inertial_sensor;
+  uint8_t hardware_version[3]; ///< major, minor, patch
+  uint8_t firmware_version[3]; ///< major, minor, patch
+  FeedbackType valid; ///< 한 번이라도 수신한 sub-payload
+
+  uint64_t last_update_us;
+  uint32_t packet_count;
+  uint32_t error_count;
+};
+
+/**
+ * @brief Pose estimated from encoder and gyro feedback
+ * @details 좌표계: ResetOdometry() 시점의 위치가 원점, 앞이 x, 왼쪽이 y, 반시계 방향 각도가 양수
+ */
+struct OdometryStatus
+{
+  bool valid; ///< 기준 encoder 값을 받았는지
+  uint16_t left_encoder; ///< 직전 feedback 의 encoder
+  uint16_t right_encoder;
+  int16_t angle; ///< 직전 feedback 의 gyro 각도 0.01 degree 단위
+
+  double x_mm;
+  double y_mm;
+  double theta_rad;
+  double left_mm; ///< 누적 바퀴 이동 거리 (calibration)
+  double right_mm;
+  uint64_t update_us;
+  uint32_t update_count;
+};
+
+/**
+ * @brief Safety reflex status
+ */
+struct ReflexStatus
+{
+  ReflexType mask; ///< 사용하는 센서, kReflexType_None: 사용 안함
+  int backoff_speed; ///< mm/s 단위, 0: stop 만 전송
+  uint8_t backoff_frame[SPEED_FRAME_LEN]; ///< 미리 만들어 둔 back-off 패킷
+  ReflexType active; ///< 직전 feedback 의 센서 상태
+
+  uint32_t count;
+  ReflexType last_type;
+  uint64_t last_rx_us; ///< 마지막 reflex 의 feedback 수신 시각
+  uint64_t last_tx_us; ///< 마지막 reflex 의 stop 전송 시각
+  int latency_max_us; ///< feedback 수신부터 stop 전송까지 최대 시간 (monotonic)
+};
+
+/**
+ * @brief Reliable header prepended to every UDP frame
+ * @details seq 는 전송마다 증가하고, epoch 는 sub-payload 별 상태가 바뀔 때마다 증가한다.
+ *          재전송은 같은 epoch 에 새 seq 를 사용한다.
+ */
+struct ReliableHeader
+{
+  uint8_t magic;
+  uint8_t frame_type;
+  uint16_t session; ///< driver 실행마다 바뀌는 값, bridge 의 epoch 초기화용
+  uint16_t seq;
+  uint16_t epoch;
+} __attribute__((__packed__));
+
+/**
+ * @brief Ack frame format (bridge -> driver)
+ */
+struct ReliableAckFormat
+{
+  struct ReliableHeader header;
+  uint8_t sub_payload_id;
+} __attribute__((__packed__));
+
+/**
+ * @brief Timed command header, the bridge applies the KOBUKI packet at exec_time_us
+ */
+struct TimedCommandHeader
+{
+  struct ReliableHeader header;
+  uint32_t exec_time_us; ///< bridge 시계 기준 실행 시각
+} __attribute__((__packed__));
+
+/**
+ * @brief Key of a "<key> <value>" configuration file
+ */
+struct ConfigKey
+{
+  const char *name;
+  size_t offset; ///< 설정 구조체 안의 위치
+  bool is_float; ///< true: float, false: int
+};
+
+/**
+ * @brief Per-robot kinematic profile, loaded with --profile <file> and written by --calibrate <file>
+ * @details 기본값은 예전 상수와 같은 이동 시간을 만든다.
+ */
+struct KinematicProfile
+{
+  float wheel_base_mm; ///< 회전 반경에 절반을 더한다
+  float tick_mm; ///< encoder 1 tick 당 이동 거리
+  float speed_gain; ///< 실제 속도 / 명령 속도 (직선)
+  int time_offset_ms; ///< 가속, 감속으로 늘어나는 직선 이동 시간
+  float spin_radius_mm; ///< 제자리 회전: 이동 시간 = 각도(rad) * spin_radius / 속도
+  float arc_gain; ///< 곡선: 이동 시간 = 반경 * 각도(rad) * arc_gain / 속도
+  int latency_ms; ///< 명령 실행부터 바퀴가 움직이기까지의 지연, 속도 명령을 그만큼 먼저 실행한다
+};
+
+/**
+ * @brief Link policy, tunable with --link-policy <file>
+ * @details 상태별 배열은 kLinkState_* 를 index 로 사용한다.
+ */
+struct LinkPolicy
+{
+  float degraded_loss; ///< 손실률이 이 값 이상이면 Degraded
+  float poor_loss;
+  int degraded_rtt_ms; ///< srtt 가 이 값 이상이면 Degraded
+  int poor_rtt_ms;
+  int lost_timeout_ms;
+  int recover_ms;
+  int copies[kLinkState_Max]; ///< base control frame 을 보내는 횟수
+  int keepalive_ms[kLinkState_Max]; ///< 전송이 없을 때 최신 base control 상태를 다시 보내는 간격, 0: 사용 안함
+  int speed_max[kLinkState_Max]; ///< 최대 속도 mm/s 단위, 0: 제한 없음
+};
+
+/**
+ * @brief Link quality status
+ */
+struct LinkStatus
+{
+  struct LinkPolicy policy;
+  LinkState state;
+  uint64_t state_since_us;
+  uint64_t better_since_us; ///< 더 좋은 상태가 시작된 시각, 0: 없음
+  uint64_t last_rx_us; ///< bridge 로부터 마지막으로 frame 을 받은 시각
+  int request_speed; ///< 마지막으로 요청한 base control 속도 (제한 전), 0: 정지
+  int request_radius; ///< 마지막으로 요청한 base control 반지름
+  uint64_t request_time_us; ///< 마지막으로 요청한 base control 실행 시각, 0: 즉시 실행
+  int applied_speed; ///< link 상태로 제한해 전송한 속도
+
+  uint32_t transition_count;
+  uint64_t state_time_us[kLinkState_Max];
+  uint32_t duplicate_count;
+  uint32_t keepalive_count;
+  uint32_t clamp_count;
+  uint32_t lost_count;
+};
+
+/**
+ * @brief Clock synchronisation frame format (NTP style)
+ */
+struct SyncFormat
+{
+  struct ReliableHeader header;
+  uint32_t t1; ///< driver 송신 시각 (driver 시계)
+  uint32_t t2; ///< bridge 수신 시각 (bridge 시계)
+  uint32_t t3; ///< bridge 송신 시각 (bridge 시계)
+} __attribute__((__packed__));
+
+/**
+ * @brief Newest state of one sub-payload, kept until acked
+ */
+struct ReliableState
+{
+  uint8_t sub_payload_id;
+  uint16_t epoch;
+  bool acked;
+  uint8_t frame[RELIABLE_FRAME_MAX_LEN];
+  size_t frame_len;
+  uint16_t last_seq; ///< 마지막 전송의 seq
+  uint64_t exec_time_us; ///< 실행 시각 (driver 시계), 0: 즉시 실행
+  uint64_t first_send_us; ///< 해당 epoch 최초 전송 시각
+  uint64_t trace_send_ns; ///< ack_confirm span 시작 시각, 0: tracing 안함
+  uint32_t command_id; ///< 상태를 만든 명령 ID
+  uint64_t last_send_us;
+};
+
+/**
+ * @brief Transmission record for RTT and loss estimation
+ */
+struct ReliableSent
+{
+  uint16_t seq;
+  bool pending;
+  bool acked; ///< 첫 ack 수신, 같은 seq 로 보낸 사본의 ack 는 다시 세지 않는다
+  uint64_t send_us;
+};
+
+/**
+ * @brief Reliable layer status and statistics
+ */
+struct ReliableStatus
+{
+  uint16_t session;
+  uint16_t next_seq;
+  int states_size;
+  struct ReliableState states[RELIABLE_STATE_MAX];
+  struct ReliableSent sent[RELIABLE_SENT_WINDOW];
+
+  int srtt_us; ///< smoothed RTT, 0: 측정값 없음
+  int rttvar_us;
+  int rtt_min_us;
+  int rtt_max_us;
+  int rto_us;
+  float loss_rate; ///< EWMA 손실률 (0.0 ~ 1.0)
+  int state_time_max_us; ///< 상태 변경 후 ack 까지 걸린 최대 시간
+
+  uint64_t last_tx_us; ///< 마지막 전송 시각 (keepalive 기준)
+  uint16_t keepalive_seq;
+  bool keepalive_pending;
+
+  uint32_t tx_count;
+  uint32_t retransmit_count;
+  uint32_t ack_count; ///< seq 별 첫 ack
+  uint32_t duplicate_ack_count; ///< 같은 seq 사본의 ack
+  uint32_t stale_ack_count;
+  uint32_t lost_count;
+};
+
+/**
+ * @brief Clock offset/RTT sample
+ */
+struct SyncSample
+{
+  uint32_t offset_us; ///< bridge 시계 - driver 시계 (modulo 2^32)
+  int rtt_us;
+};
+
+/**
+ * @brief Host-bridge clock synchronisation status
+ */
+struct SyncStatus
+{
+  bool valid;
+  uint32_t offset_us; ///< 최소 RTT sample 의 offset
+  int rtt_us; ///< 최소 RTT sample 의 RTT
+  int lead_ms;
+  struct SyncSample samples[SYNC_SAMPLE_MAX];
+  int samples_size;
+  int sample_index;
+  int requests_size;
+  uint64_t next_request_us;
+  uint32_t response_count;
+};
+
+/**
+ * @brief Set-point published by a client process through shared memory
+ */
+struct SharedCommand
+{
+  uint32_t command_id; ///< PublishSharedCommand() 에서 할당
+  int speed; ///< mm/s 단위
+  int radius; ///< mm 단위
+  uint8_t led_mask; ///< 변경할 LED (SHARED_LED_*), 0: LED 변경 없음
+  LEDColor led_color[2];
+  uint64_t publish_us; ///< GetTimeUs() 시각 (CLOCK_MONOTONIC, 프로세스 간 공통)
+};
+
+/**
+ * @brief Sensor-state snapshot published by the driver through shared memory
+ */
+struct SharedState
+{
+  struct BasicSensorFormat basic_sensor;
+  struct InertialSensorFormat inertial_sensor;
+  FeedbackType valid;
+  uint64_t feedback_us; ///< 마지막 feedback 수신 시각
+  ReflexType reflex_active;
+  uint32_t reflex_count;
+  uint32_t applied_command_id; ///< 마지막으로 처리한 SharedCommand (거부한 명령 포함)
+  uint32_t rejected_command_id; ///< reflex 로 전진 속도를 거부한 마지막 SharedCommand
+  uint64_t applied_us;
+  int srtt_us;
+  float loss_rate;
+};
+
+/**
+ * @brief POSIX shared-memory region
+ * @details command, state 는 각각 seqlock 으로 보호한다. seq 가 홀수이면 쓰는 중이고,
+ *          seq 는 futex word 로도 사용되어 값이 바뀔 때 대기 중인 프로세스를 깨운다.
+ *          writer 는 waiters 가 0 이면 futex wake 를 생략한다.
+ */
+struct SharedRegion
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size; ///< sizeof(struct SharedRegion)
+  int32_t driver_pid;
+
+  uint32_t command_seq __attribute__((aligned(64)));
+  uint32_t command_waiters;
+  uint32_t next_command_id;
+  struct SharedCommand command;
+
+  uint32_t state_seq __attribute__((aligned(64)));
+  uint32_t state_waiters;
+  struct SharedState state;
+};
+
+/**
+ * @brief Trace span (Chrome trace "X" event)
+ */
+struct TraceEvent
+{
+  const char *name;
+  uint32_t command_id;
+  uint64_t duration_ns;
+  uint64_t begin_ns;
+};
+
+/**
+ * @brief Per-thread trace buffer
+ */
+struct TraceBuffer
+{
+  struct TraceBuffer *next;
+  int tid;
+  uint32_t events_size;
+  uint32_t dropped_count;
+  struct TraceEvent events[TRACE_BUFFER_EVENTS];
+};
+
+/**
+ * @brief Frame or bridge action scheduled by the simulated bridge
+ */
+struct SimEvent
+{
+  uint64_t due_us;
+  bool apply; ///< true: bridge 가 KOBUKI 패킷을 적용, false: driver 로 frame 전달
+  uint8_t sub_payload_id;
+  uint16_t epoch;
+  uint8_t frame[SIM_FRAME_MAX_LEN];
+  size_t frame_len;
+};
+
+/**
+ * @brief Simulated bridge settings (--sim-config)
+ */
+struct SimConfig
+{
+  int rtt_us; ///< driver-bridge 왕복 시간
+  int feedback_ms; ///< basic/inertial sensor feedback 주기, 0: 보내지 않음
+  float loss; ///< 양방향 frame 손실률 (%)
+  int seed; ///< 손실 난수 seed, 같은 seed 면 같은 frame 이 손실된다
+  int loss_at_ms; ///< 첫 frame 부터 손실 시작까지 시간
+  int loss_for_ms; ///< 손실 구간 길이, 0: 끝까지
+  int outage_at_ms; ///< 첫 frame 부터 모든 frame 을 버리기 시작할 때까지 시간, 음수: 끊김 없음
+  int outage_for_ms; ///< 끊김 구간 길이
+  int bumper_at_ms; ///< 첫 frame 부터 중앙 bumper 를 누를 때까지 시간, 음수: 누르지 않음
+  int bumper_for_ms; ///< bumper 를 누르고 있는 시간
+  int bumper_every_ms; ///< bumper 를 다시 누르는 주기, 0: 한 번만
+};
+
+/**
+ * @brief Simulated bridge for virtual-clock runs
+ */
+struct SimStatus
+{
+  struct SimConfig config;
+  bool initialized; ///< InitSim() 성공, CloseSim() 전
+  uint16_t session; ///< 마지막으로 수신한 driver session
+  struct SimEvent queue[SIM_QUEUE_MAX];
+  int queue_size;
+  uint16_t next_seq;
+  bool sent[256]; ///< sub-payload 별 송신 여부
+  uint16_t sent_epoch[256]; ///< 재전송 구분용
+  uint16_t tx_seq[256]; ///< driver 가 마지막으로 보낸 seq (손실 포함), 같은 seq 사본 구분용
+  uint16_t tx_epoch[256]; ///< driver 가 마지막으로 보낸 epoch (손실 포함)
+  uint64_t tx_epoch_us[256]; ///< tx_epoch 를 처음 보낸 시각, 0: 보낸 적 없음
+  uint32_t random; ///< 손실 난수 상태 (xorshift32)
+  bool applied[256];
+  uint16_t applied_epoch[256];
+  FILE *timeline; ///< frame timeline (CSV), NULL: 기록 안함
+  uint64_t wall_start_us;
+  uint64_t start_us; ///< 첫 frame 수신 시각, 0: 수신 전
+  uint64_t feedback_due_us; ///< 다음 sensor feedback 시각, 0: 보내지 않음
+
+  /* 적용한 base control 로 움직이는 KOBUKI (profile 기본값의 바퀴 간격) */
+  int speed;
+  int radius;
+  double left_mm; ///< 바퀴 이동 거리
+  double right_mm;
+  double theta_rad;
+  uint64_t move_us; ///< 마지막으로 이동을 계산한 시각
+
+  uint32_t tx_count;
+  uint32_t loss_count; ///< 손실시킨 frame (양방향)
+  uint32_t delivery_count; ///< bridge 에 도착한 새 base control epoch
+  uint32_t delivery_rtt_count; ///< 처음 보낸 뒤 rtt_us 안에 도착한 새 base control epoch
+  int delivery_max_us; ///< 새 base control epoch 를 처음 보낸 뒤 도착까지 최대 시간
+  uint32_t apply_count;
+  uint32_t drop_count; ///< 적용 시각에 더 새로운 상태가 있어 버린 frame
+};
+
+/**
+ * @brief Command line in script file
+ * 
+ */
+struct ScriptLine
+{
+  CommandType type;
+  int speed; ///< 이동 속도 mm/s 단위
+  int radius; ///< 회전 반경 mm 단위
+	float radian; ///< 회전 각도
+	int distance; ///< 이동 거리 mm 단위
+	int move_time; ///< 속도, 이동 거리로 이동 시간 계산 ms 단위
+  int x; ///< waypoint 위치 mm 단위, 시작 위치 기준 앞쪽
+  int y; ///< waypoint 위치 mm 단위, 시작 위치 기준 왼쪽
+
+  int delay; ///< ms 단위
+  
+  int led_num;
+  int color;
+
+  bool clamped; ///< 범위를 벗어나 제한된 값(NaN 포함)이 있음, reload 는 이 script 를 거부한다.
+};
+
+/**
+ * @brief Parsed script, double-buffered for hot reload
+ */
+struct Script
+{
+  int lines_size;
+  struct ScriptLine lines[SCRIPT_COMMAND_MAX_LEN];
+};
+
+/**
+ * @brief Global MIB
+ * 
+ */
+struct MIB
+{
+  char server_ip_addr[16];
+  int server_port_num;
+
+  int device;
+  struct termios newtio;
+  uint16_t led_status;
+  uint16_t speed_status;
+  uint16_t radius_status;
+
+  char device_name[SCRIPT_COMMAND_MAX_LEN];
+  char baud_rate[SCRIPT_COMMAND_MAX_LEN];
+  int log_level;
+  int sync_lead_ms; ///< 0: 시각 지정 명령 사용 안함
+  int ready_timeout_ms; ///< 0: 연결 확인 안함
+  bool boot_led; ///< 시작 시 LED 점등 동작 사용
+  ReflexType reflex_mask; ///< kReflexType_None: reflex 사용 안함
+  int reflex_backoff_speed; ///< mm/s 단위
+  char script_file_name[SCRIPT_COMMAND_MAX_LEN];
+  struct Script scripts[2]; ///< 실행 중인 script 와 새로 읽은 script
+  struct Script *script; ///< 실행 중인 script, scripts[] 중 하나
+
+  struct sockaddr_in server_addr;
+  int socket;
+
+  struct ReliableStatus reliable;
+  struct SyncStatus sync;
+  struct FeedbackStatus feedback;
+  struct ReflexStatus reflex;
+  struct OdometryStatus odometry;
+  struct LinkStatus link;
+  char link_policy_file_name[SCRIPT_COMMAND_MAX_LEN]; ///< 빈 문자열: 기본 정책
+  struct KinematicProfile profile;
+  char profile_file_name[SCRIPT_COMMAND_MAX_LEN]; ///< 빈 문자열: 기본 profile
+  char calibrate_file_name[SCRIPT_COMMAND_MAX_LEN]; ///< 빈 문자열: calibration 안함
+  uint64_t command_time_us; ///< 다음 명령의 실행 시각 (driver 시계), 0: 즉시 실행
+  EventType events; ///< WaitEvent() 에 전달되지 않은 이벤트
+  uint64_t rx_monotonic_us; ///< 처리 중인 UDP frame 을 user-space 에서 받은 시각 (monotonic, decode 전)
+  int signal_event_fd; ///< 종료 시그널 핸들러가 쓰는 eventfd
+  int terminate_signal; ///< 수신한 종료 시그널, 0: 없음
+  uint64_t terminate_signal_us; ///< 종료 시그널 전달 시각 (monotonic)
+  int stop_latency_us; ///< 종료 시그널 전달(핸들러)부터 stop 전송까지 걸린 시간
+  uint8_t stop_frame[SPEED_FRAME_LEN]; ///< 미리 만들어 둔 stop 패킷
+  uint64_t start_us; ///< 어플리케이션 시작 시각
+
+  char shared_name[SHARED_NAME_MAX_LEN]; ///< 공유 메모리 이름, 빈 문자열: 사용 안함
+  struct SharedRegion *shared;
+  int shared_event_fd; ///< 공유 메모리 명령 수신 시 helper thread 가 쓰는 eventfd
+  ReloadMode reload_mode;
+  int reload_event_fd; ///< 새 script 를 읽으면 watch thread 가 쓰는 eventfd
+  uint32_t shared_command_id; ///< 마지막으로 처리한 SharedCommand
+  uint32_t shared_rejected_id; ///< reflex 로 전진 속도를 거부한 마지막 SharedCommand
+
+  ClockType clock_type;
+  const struct ClockOps *clock; ///< NULL: monotonic
+  char timeline_file_name[SCRIPT_COMMAND_MAX_LEN]; ///< 빈 문자열: 기록 안함
+  char sim_config_file_name[SCRIPT_COMMAND_MAX_LEN]; ///< 빈 문자열: 시뮬레이션 bridge 기본 설정
+  struct SimStatus sim;
+
+  char trace_file_name[SCRIPT_COMMAND_MAX_LEN]; ///< 빈 문자열: tracing 안함
+  uint32_t command_id; ///< 현재 명령 ID, trace span 에 기록된다
+};
+
+extern struct MIB g_mib;
+extern bool g_trace_enabled;
+
+/**
+ * @brief Tracing span macros
+ * @details KOBUKI_ENABLE_TRACE 로 빌드하면 포함되고, StartTrace() 전에는 분기 하나의 비용만 든다.
+ *          TRACE_BEGIN(span); ... TRACE_END(span, "name");
+ */
+#ifdef KOBUKI_ENABLE_TRACE
+#define TRACE_NOW() (g_trace_enabled ? GetTraceTimeNs() : 0)
+#define TRACE_BEGIN(span) uint64_t span = TRACE_NOW()
+#define TRACE_END_ID(span, name, id) \
+  do { \
+    if ((span) != 0) { \
+      TraceSpan((name), (id), (span), GetTraceTimeNs()); \
+    } \
+  } while (0)
+#else
+#define TRACE_NOW() 0
+#define TRACE_BEGIN(span) do { } while (0)
+#define TRACE_END_ID(span, name, id) do { } while (0)
+#endif
+#define TRACE_END(span, name) TRACE_END_ID(span, name, g_mib.command_id)
+
+/* kobuki-fun.c */
+void PrintLog(MessageType msg_type, const char *format, ...);
+void PrintHexDump(MessageType msg_Type, CommandType command_type, const char *format, void *command);
+uint8_t KOBUKI_Checksum(const uint8_t *packet, size_t packet_len);
+int KOBUKI_ControlLED(int device, int led_num, int color);
+size_t KOBUKI_EncodeSpeed(uint8_t *frame, int speed, int radius);
+int KOBUKI_ControlSpeed(int device, int speed, int radius);
+int KOBUKI_EmergencyStop(void);
+int KOBUKI_RequestExtra(int device, uint16_t request_flags);
+int ParseScriptCommand(const char *script_file, const struct KinematicProfile *profile, struct Script *script);
+int ParseScriptStream(FILE *fp, const struct KinematicProfile *profile, struct Script *script);
+int LoadConfigFile(const char *config_file, const struct ConfigKey *keys, size_t keys_size, void *config);
+
+/* kobuki-udp.c */
+int InitUDP(const char *ip_addr, const int port_num, struct sockaddr_in *server_addr, int *socket);
+int SendUDPMessage(int m_socket, struct sockaddr_in server_addr, char *payload, size_t payload_size);
+int RecvUDPMessage(int m_socket, char *buf, size_t buf_size);
+
+/* kobuki-reliable.c */
+void InitReliable(struct ReliableStatus *reliable);
+int SendReliableState(uint8_t sub_payload_id, const uint8_t *frame, size_t frame_len);
+int SendReliableStateAt(uint8_t sub_payload_id, const uint8_t *frame, size_t frame_len, uint64_t exec_time_us);
+int HandleReliableAck(const uint8_t *buf, size_t len, uint64_t now_us);
+int ServiceReliable(uint64_t now_us);
+bool IsReliableSettled(void);
+bool IsReliableStateAcked(uint8_t sub_payload_id);
+int SendReliableKeepalive(uint8_t sub_payload_id, uint64_t now_us);
+void PrintReliableStatus(void);
+
+/* kobuki-sync.c */
+void InitSync(struct SyncStatus *sync, int lead_ms);
+int HandleSyncResponse(const uint8_t *buf, size_t len, uint64_t now_us);
+int ServiceSync(uint64_t now_us);
+bool GetBridgeTime(uint64_t local_us, uint32_t *bridge_us);
+uint64_t GetSyncLeadUs(void);
+void SetCommandTime(uint64_t local_us);
+void PrintSyncStatus(void);
+
+/* kobuki-feedback.c */
+int ParseFeedbackPacket(const uint8_t *packet, size_t packet_len, struct FeedbackStatus *feedback);
+int HandleFeedback(const uint8_t *buf, size_t len, uint64_t now_us);
+void InitReflex(struct ReflexStatus *reflex, ReflexType mask, int backoff_speed);
+void PrintReflexStatus(void);
+
+/* kobuki-link.c */
+void InitLink(struct LinkStatus *link);
+int LoadLinkPolicy(const char *policy_file, struct LinkPolicy *policy);
+int ServiceLink(uint64_t now_us);
+int GetLinkCopies(uint8_t sub_payload_id);
+int LimitLinkSpeed(int speed);
+void PrintLinkStatus(void);
+
+/* kobuki-calib.c */
+void InitProfile(struct KinematicProfile *profile);
+int LoadProfile(const char *profile_file, struct KinematicProfile *profile);
+int SaveProfile(const char *profile_file, const struct KinematicProfile *profile);
+int RunCalibration(const char *profile_file);
+
+/* kobuki-waypoint.c */
+void ResetOdometry(void);
+void UpdateOdometry(FeedbackType decoded, uint64_t now_us);
+int FollowWaypoints(const struct ScriptLine *lines, int lines_size);
+
+/* kobuki-reload.c */
+int StartScriptWatch(const char *script_file, int *event_fd);
+bool SwapScript(void);
+
+/* kobuki-shm.c */
+int OpenSharedRegion(const char *name, bool create, struct SharedRegion **region);
+void CloseSharedRegion(struct SharedRegion *region, const char *name, bool remove);
+uint32_t PublishSharedCommand(struct SharedRegion *region, const struct SharedCommand *command);
+uint32_t ReadSharedCommand(struct SharedRegion *region, struct SharedCommand *command);
+void PublishSharedState(struct SharedRegion *region, const struct SharedState *state);
+uint32_t ReadSharedState(struct SharedRegion *region, struct SharedState *state);
+int WaitSharedState(struct SharedRegion *region, uint32_t seq, int timeout_ms);
+int StartSharedNotify(struct SharedRegion *region, int *event_fd);
+void StopSharedNotify(void);
+void UpdateSharedState(void);
+int ApplySharedCommand(void);
+
+/* kobuki-sim.c */
+void InitSimConfig(struct SimConfig *config);
+int LoadSimConfig(const char *config_file, struct SimConfig *config);
+int InitSim(struct SimStatus *sim, const struct SimConfig *config, const char *timeline_file);
+int SimSendFrame(const uint8_t *buf, size_t len);
+int SimRecvFrame(uint8_t *buf, size_t buf_size);
+uint64_t SimNextDueUs(void);
+void CloseSim(void);
+
+/* kobuki-trace.c */
+uint64_t GetTraceTimeNs(void);
+void StartTrace(void);
+void TraceSpan(const char *name, uint32_t command_id, uint64_t begin_ns, uint64_t end_ns);
+int WriteTrace(const char *trace_file);
+
+/* kobuki-event.c */
+uint64_t GetMonotonicTimeUs(void);
+uint64_t GetTimeUs(void);
+void SetClock(ClockType clock_type);
+int InitSignal(int *signal_event_fd);
+void BlockTerminateSignals(sigset_t *old_mask);
+int WaitEvent(int wait_ms, EventType wake_mask);
+int WaitEventUntil(uint64_t deadline_us, EventType wake_mask);
\ No newline at end of file
@@ -0,0 +1,19 @@
+#!/bin/sh
+# Reflex against the local bridge: the bumper pressed 0.5 s into a move for 0.5 s is one edge, stopped once,
+# within 1 ms of receiving the feedback frame, and the bridge executes the stop.
+. "$(dirname "$0")/common.sh"
+require_bridge
+
+printf 'speed 1 0 0 0.5\nsleep 500\n' > "$WORK/bumper.txt"
+start_bridge 5633 --bumper-at 0.5
+run_driver --ip 127.0.0.1 --port 5633 --script "$WORK/bumper.txt"
+stop_bridge
+assert_eq "$STATUS" 0 "driver exit status"
+
+assert_eq "$(grep -c "Reflex - type" "$WORK/driver.log")" 1 "reflex stops for one press"
+assert_eq "$(log_value "$WORK/driver.log" "Reflex status" count)" 1 "reflex count"
+assert_le "$(log_value "$WORK/driver.log" "Reflex status" latency_max | tr -d us)" 999 "feedback to stop latency (us)"
+# 움직이는 base control 다음에 bridge 가 실행한 base control 은 reflex stop 이다.
+grep -io ' AA55..0104[0-9A-F]*' "$WORK/bridge.log" | awk 'moving { print; exit } !/0104000000/ { moving = 1 }' |
+  grep -qi '0104000000' || fail "bridge did not execute the reflex stop"
+pass "bridge executed the reflex stop"
@@ -0,0 +1,101 @@
+# Helpers for the end-to-end tests, sourced by test/*.sh
+# KOBUKI: driver binary, BRIDGE: wifi-udp/wifi-linux.py, PYTHON2: bridge interpreter (set by CTest)
+set -u
+
+SKIP=77
+WORK=$(mktemp -d)
+BRIDGE_PID=
+
+cleanup()
+{
+  if [ -n "$BRIDGE_PID" ]; then
+    kill "$BRIDGE_PID" 2>/dev/null
+  fi
+  rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+fail()
+{
+  echo "FAIL: $*"
+  if [ -f "$WORK/driver.log" ]; then
+    echo "--- driver log (tail)"
+    tail -n 30 "$WORK/driver.log"
+  fi
+  if [ -f "$WORK/bridge.log" ]; then
+    echo "--- bridge log (tail)"
+    tail -n 10 "$WORK/bridge.log"
+  fi
+  exit 1
+}
+
+pass()
+{
+  echo "PASS: $*"
+}
+
+# driver 를 실행한다. 색상 코드를 지운 로그: $WORK/driver.log, exit status: $STATUS
+run_driver()
+{
+  "$KOBUKI" --dbg 3 "$@" > "$WORK/driver.raw" 2>&1
+  STATUS=$?
+  sed 's/\x1b\[[0-9;]*m//g' "$WORK/driver.raw" > "$WORK/driver.log"
+}
+
+# 로그에서 pattern 이 있는 마지막 줄의 "<key>: <number>" 값
+# usage: log_value <file> <pattern> <key>
+log_value()
+{
+  grep -e "$2" "$1" | tail -n 1 | sed -n "s/.*[ (,]$3: \(-\{0,1\}[0-9.]*\).*/\1/p"
+}
+
+# usage: assert_le <value> <max> <description>
+assert_le()
+{
+  if [ -z "$1" ]; then
+    fail "$3: no value"
+  fi
+  if awk -v value="$1" -v max="$2" 'BEGIN { exit !(value <= max) }'; then
+    pass "$3: $1 <= $2"
+  else
+    fail "$3: $1 > $2"
+  fi
+}
+
+# usage: assert_eq <value> <expected> <description>
+assert_eq()
+{
+  if [ "$1" = "$2" ]; then
+    pass "$3: $1"
+  else
+    fail "$3: $1 != $2"
+  fi
+}
+
+# wifi-linux.py 는 python2 로 실행한다. 없으면 test 를 건너뛴다.
+require_bridge()
+{
+  if [ -z "${PYTHON2:-}" ] || ! "$PYTHON2" -c 'print 1' > /dev/null 2>&1; then
+    echo "SKIP: no python2 interpreter for $BRIDGE (set KOBUKI_PYTHON2)"
+    exit $SKIP
+  fi
+}
+
+# local bridge 를 실행한다. 로그: $WORK/bridge.log
+# usage: start_bridge <port> [wifi-linux.py options]
+start_bridge()
+{
+  port=$1
+  shift
+  "$PYTHON2" -u "$BRIDGE" --ip 127.0.0.1 --port "$port" --local "$@" > "$WORK/bridge.log" 2>&1 &
+  BRIDGE_PID=$!
+  sleep 0.5
+}
+
+# bridge 를 종료하고 통계 출력을 기다린다.
+stop_bridge()
+{
+  kill -TERM "$BRIDGE_PID"
+  wait "$BRIDGE_PID"
+  BRIDGE_PID=
+}
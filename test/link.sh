@@ -0,0 +1,38 @@
+#!/bin/sh
+# Link quality on the simulated bridge: 15% loss for 3 s, then a 2 s outage, then a clean link.
+# The link goes good -> degraded -> lost -> good, sends a stop when lost, and clamps the speed while degraded.
+. "$(dirname "$0")/common.sh"
+
+: > "$WORK/link.txt"
+for i in $(seq 1 14); do
+  printf 'speed 2 0 0 0.5\n' >> "$WORK/link.txt"
+done
+printf 'loss 15\nloss_for_ms 3000\noutage_at_ms 4000\noutage_for_ms 2000\n' > "$WORK/link.cfg"
+run_driver --virtual --sim-config "$WORK/link.cfg" --script "$WORK/link.txt" --timeline "$WORK/timeline.csv"
+assert_eq "$STATUS" 0 "link run exit status"
+
+# 로그 순서: good -> degraded, lost, -> good
+degraded=$(grep -n "Link good -> degraded" "$WORK/driver.log" | head -n 1 | cut -d: -f1)
+lost=$(grep -n "Link lost - " "$WORK/driver.log" | head -n 1 | cut -d: -f1)
+[ -n "$degraded" ] && [ -n "$lost" ] && [ "$degraded" -lt "$lost" ] || fail "no good -> degraded before lost"
+tail -n +"$lost" "$WORK/driver.log" | grep -q "Link [a-z]* -> good" || fail "link did not recover to good after lost"
+grep -q "Link status - state: good" "$WORK/driver.log" || fail "link is not good at exit"
+pass "good -> degraded -> lost -> good"
+
+# Lost: 끊김 중에 즉시 실행 stop 을 보내고, 끊김이 끝나고 recover_ms 가 지나기 전에는 bridge 가 움직이지 않는다.
+awk -F, '$1 >= 4000 && $1 < 6000 && $3 == 1 && $6 == "0x01" && $8 == "speed=0 radius=0"' "$WORK/timeline.csv" | grep -q . ||
+  fail "no stop sent during the outage"
+pass "stop sent when the link was lost"
+moving=$(awk -F, '$2 == "apply" && $6 == "0x01" && $1 >= 4000 && $1 < 8000 && $8 != "speed=0 radius=0"' "$WORK/timeline.csv" | wc -l)
+assert_eq "$moving" 0 "speed commands applied while lost"
+
+grep -q "Limit speed by link state - state: degraded, speed: 555 -> 300" "$WORK/driver.log" || fail "speed not clamped while degraded"
+grep -q ',apply,.*,0x01,,speed=300 radius=0' "$WORK/timeline.csv" || fail "clamped speed not applied"
+pass "speed clamped to 300 mm/s while degraded"
+
+# 나빠지는 순간 실행 중인 구간도 새 최대 속도로 다시 전송하고, 제한된 구간은 같은 거리를 가도록 늘린다.
+grep -q "Limit running speed by link state - state: degraded, speed: 555 -> 300" "$WORK/driver.log" ||
+  fail "running speed not limited when the link got worse"
+grep -q "Extend segment by link speed limit - speed: 555 -> 300, move_time: 900ms -> 1665ms" "$WORK/driver.log" ||
+  fail "clamped segment not extended"
+pass "running segment limited and clamped segments extended"
@@ -0,0 +1,25 @@
+#!/bin/sh
+# 10% loss both ways on the simulated bridge: duplicate acks are counted once per seq, keepalives are labelled as such
+# in the timeline, and the commanded speed reaches the bridge within one RTT (copies sent on the degraded link).
+. "$(dirname "$0")/common.sh"
+
+: > "$WORK/lossy.txt"
+for i in $(seq 1 24); do
+  printf 'speed 1 0 0 0.02\nsleep 30\nspeed -1 0 0 0.02\nsleep 30\n' >> "$WORK/lossy.txt"
+done
+printf 'sleep 1000\n' >> "$WORK/lossy.txt"
+printf 'loss 10\nseed 1\n' > "$WORK/loss.cfg"
+run_driver --virtual --sim-config "$WORK/loss.cfg" --script "$WORK/lossy.txt" --timeline "$WORK/timeline.csv"
+assert_eq "$STATUS" 0 "lossy run exit status"
+
+tx=$(log_value "$WORK/driver.log" "Reliable status - tx" tx)
+assert_le "$(log_value "$WORK/driver.log" "Reliable status - tx" ack)" "$tx" "acks counted once per seq (tx: $tx)"
+grep -q ',keepalive,' "$WORK/timeline.csv" || fail "no keepalive in the timeline"
+grep -q ',duplicate,' "$WORK/timeline.csv" || fail "no duplicate in the timeline"
+pass "keepalive and duplicate frames are labelled"
+
+delivery=$(log_value "$WORK/driver.log" "Simulated link status" delivery)
+in_rtt=$(log_value "$WORK/driver.log" "Simulated link status" delivery_in_rtt)
+assert_le "$(awk -v all="$delivery" -v in_rtt="$in_rtt" 'BEGIN { print (all - in_rtt) * 100 / all }')" 3 \
+  "speed states later than one RTT (% of $delivery)"
+assert_le "$(log_value "$WORK/driver.log" "Simulated link status" delivery_max | tr -d us)" 20000 "speed state delivery max (us)"
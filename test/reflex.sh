@@ -0,0 +1,21 @@
+#!/bin/sh
+# Reflex on the simulated bridge: the bumper is pressed for 300 ms every 2 s, and each press (rising edge)
+# sends exactly one immediate stop, however many feedback frames report it.
+. "$(dirname "$0")/common.sh"
+
+: > "$WORK/reflex.txt"
+for i in $(seq 1 6); do
+  printf 'speed 1 0 0 0.3\nsleep 500\n' >> "$WORK/reflex.txt"
+done
+printf 'sleep 1000\n' >> "$WORK/reflex.txt"
+printf 'bumper_at_ms 500\nbumper_for_ms 300\nbumper_every_ms 2000\n' > "$WORK/bumper.cfg"
+run_driver --virtual --sim-config "$WORK/bumper.cfg" --script "$WORK/reflex.txt" --timeline "$WORK/timeline.csv"
+assert_eq "$STATUS" 0 "reflex run exit status"
+
+presses=$(awk -F, '$2 == "tx" { t = $1 } END { n = 0; for (at = 500; at < t; at += 2000) n++; print n }' "$WORK/timeline.csv")
+assert_eq "$(log_value "$WORK/driver.log" "Reflex status" count)" "$presses" "reflex count for $presses presses"
+for at in $(seq 500 2000 $(( (presses - 1) * 2000 + 500 ))); do
+  stops=$(awk -F, -v at="$at" '$2 == "tx" && $3 == 1 && $6 == "0x01" && $8 == "speed=0 radius=0" && $1 >= at && $1 < at + 300' \
+    "$WORK/timeline.csv" | wc -l)
+  assert_eq "$stops" 1 "stops sent for the press at ${at}ms"
+done
@@ -0,0 +1,24 @@
+#!/bin/sh
+# SIGINT in the middle of a move against the local bridge: the stop is sent within 5 ms of signal delivery,
+# acked within 50 ms, the encoders stop changing, and the last base control the bridge executes is a stop.
+. "$(dirname "$0")/common.sh"
+require_bridge
+
+printf 'speed 1 0 0 3\n' > "$WORK/move.txt"
+start_bridge 5631 --odometry 230,1,0
+"$KOBUKI" --ip 127.0.0.1 --port 5631 --script "$WORK/move.txt" --dbg 3 > "$WORK/driver.raw" 2>&1 &
+DRIVER_PID=$!
+sleep 1
+kill -INT "$DRIVER_PID"
+wait "$DRIVER_PID"
+STATUS=$?
+sed 's/\x1b\[[0-9;]*m//g' "$WORK/driver.raw" > "$WORK/driver.log"
+stop_bridge
+
+assert_eq "$STATUS" 0 "exit status after SIGINT"
+grep -q "Success to confirm stop" "$WORK/driver.log" || fail "stop was not acked"
+assert_le "$(log_value "$WORK/driver.log" "confirm stop" "signal to stop" | tr -d us)" 5000 "signal to stop (us)"
+assert_le "$(log_value "$WORK/driver.log" "confirm stop" confirm)" 50000 "signal to acked stop (us)"
+grep -q "Success to check encoders stopped" "$WORK/driver.log" || fail "encoders still moving after the stop"
+grep -i ' AA55..0104' "$WORK/bridge.log" | tail -n 1 | grep -qi '0104000000' || fail "last executed base control is not a stop"
+pass "bridge stopped the base"
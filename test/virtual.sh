@@ -0,0 +1,17 @@
+#!/bin/sh
+# Virtual clock start-up and shut-down: a run that fails before the simulated bridge starts
+# exits with status 1 without a virtual clock summary.
+. "$(dirname "$0")/common.sh"
+
+printf 'sleep 100\n' > "$WORK/sleep.txt"
+run_driver --virtual --sim-config "$WORK/missing.cfg" --script "$WORK/sleep.txt"
+assert_eq "$STATUS" 1 "missing sim config exit status"
+if grep -q "run virtual clock" "$WORK/driver.log"; then
+  fail "closed a simulated bridge that was never initialized"
+fi
+pass "no virtual clock summary before InitSim"
+
+run_driver --virtual --script "$WORK/sleep.txt"
+assert_eq "$STATUS" 0 "sleep script exit status"
+assert_eq "$(grep -c "Success to run virtual clock" "$WORK/driver.log")" 1 "virtual clock summaries"
+assert_le "$(log_value "$WORK/driver.log" "Success to run virtual clock" wall | tr -d us)" 1000000 "wall time (us)"
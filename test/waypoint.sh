@@ -0,0 +1,26 @@
+#!/bin/sh
+# Waypoint follower against the simulated bridge (--virtual):
+# a square route closes on the start point, and a route without sensor feedback stops and exits with status 1.
+. "$(dirname "$0")/common.sh"
+
+cat > "$WORK/square.txt" << EOF
+waypoint 1 0 1.8
+waypoint 1 1
+waypoint 0 1 1.8
+waypoint 0 0
+led 2 2
+EOF
+run_driver --virtual --script "$WORK/square.txt"
+assert_eq "$STATUS" 0 "square route exit status"
+assert_le "$(log_value "$WORK/driver.log" "Success to follow waypoints" error)" 100 "square route end error (mm)"
+grep -q "led_num: 2, color: Red" "$WORK/driver.log" || fail "script did not continue after the route"
+
+printf 'feedback_ms 0\n' > "$WORK/no-feedback.cfg"
+run_driver --virtual --sim-config "$WORK/no-feedback.cfg" --script "$WORK/square.txt" --timeline "$WORK/timeline.csv"
+assert_eq "$STATUS" 1 "route without feedback exit status"
+grep -q "Fail to follow waypoints - no feedback" "$WORK/driver.log" || fail "follower did not time out"
+if grep -q "led_num: 2, color: Red" "$WORK/driver.log"; then
+  fail "script continued from an unknown pose"
+fi
+grep ',0x01,' "$WORK/timeline.csv" | tail -n 1 | grep -q 'speed=0 radius=0' || fail "last base control is not a stop"
+pass "route without feedback stopped the script"
@@ -1,74 +1,134 @@
-//BridgeBlink.ino
-#include <Bridge.h>
-#include <SoftwareSerial.h>
-
-unsigned char buf[100];
-SoftwareSerial m_serial(2, 3); // (rx, tx)
-byte speed_stop[] = {0xAA, 0x55, 0x06, 0x01, 0x04, 0x00, 0x00, 0x00, 0x00};
-
-struct SpeedMessageFormat
-{
-  uint8_t header_0;
-  uint8_t header_1;
-  uint8_t payload_len;
-  uint8_t sub_payload_id;
-  uint8_t sub_payload_len;
-  uint16_t speed;
-  uint16_t radius;
-  uint8_t crc;
-};
-void setup() {
-
-  //Serial.begin(115200);
-  //while (!Serial) {
-    //;
-  //}
-  //Serial.println("Initiailize the arduino yun");
-
-  m_serial.begin(115200);
-  while (!m_serial) {
-    ;
-  }
-  //Serial.println("Success to initialize the arduino yun");
-  
-  // put your setup code here, to run once:
-  pinMode(13,OUTPUT);
-  
-  digitalWrite(13,LOW);
-  Bridge.begin();
-  digitalWrite(13,HIGH);
-  
-  delay(1000);
-  
-  digitalWrite(13,LOW);
-  Bridge.put("D13", "0");
-  //Serial.println("You're connected to the Console!!!");
-  //digitalWrite(13,HIGH);
-}
-
-void loop() {
-  // put your main code here, to run repeatedly:
-  memset(buf, 0, 100);
-  int buf_len = Bridge.get("D13",buf,100);
-  //struct SpeedMessageFormat *temp = (struct SpeedMessageFormat *)buf;
-    
-  if (buf[0] != '0') {
-    if (digitalRead(13) == HIGH) digitalWrite(13, LOW);
-    else digitalWrite(13, HIGH);
-    m_serial.write(buf, buf_len);
-    //Serial.print(timer);
-    //Serial.print(": ");
-    //Serial.println((int16_t)temp->speed);
-    //Serial.write((char *)buf, buf_len);
-    //m_serial.write((char *)buf, buf_len);
-    //Bridge.put("D13", "0");
-  }
-  else {
-    if (digitalRead(13) == HIGH) digitalWrite(13, LOW);
-    else digitalWrite(13, HIGH);
-    m_serial.write(speed_stop, sizeof(speed_stop)/sizeof(byte));
-    //Serial.println("command stop");
-  }
-  delay(50);
-  return;
-}
+//BridgeBlink.ino
+#include <Bridge.h>
+#include <SoftwareSerial.h>
+
+#define RX_BUF_SIZE 128
+#define COMMAND_PERIOD_MS 50 // D13 polling and stop flood cadence
+
+unsigned char buf[100];
+unsigned char rx_buf[RX_BUF_SIZE];
+int rx_len = 0;
+char fb_buf[2 * RX_BUF_SIZE + 4];
+byte fb_count = 0;
+unsigned long command_ms = 0;
+SoftwareSerial m_serial(2, 3); // (rx, tx)
+byte speed_stop[] = {0xAA, 0x55, 0x06, 0x01, 0x04, 0x00, 0x00, 0x00, 0x00};
+
+struct SpeedMessageFormat
+{
+  uint8_t header_0;
+  uint8_t header_1;
+  uint8_t payload_len;
+  uint8_t sub_payload_id;
+  uint8_t sub_payload_len;
+  uint16_t speed;
+  uint16_t radius;
+  uint8_t crc;
+};
+void setup() {
+
+  //Serial.begin(115200);
+  //while (!Serial) {
+    //;
+  //}
+  //Serial.println("Initiailize the arduino yun");
+
+  m_serial.begin(115200);
+  while (!m_serial) {
+    ;
+  }
+  //Serial.println("Success to initialize the arduino yun");
+  
+  // put your setup code here, to run once:
+  pinMode(13,OUTPUT);
+  
+  digitalWrite(13,LOW);
+  Bridge.begin();
+  digitalWrite(13,HIGH);
+  
+  delay(1000);
+  
+  digitalWrite(13,LOW);
+  Bridge.put("D13", "0");
+  //Serial.println("You're connected to the Console!!!");
+  //digitalWrite(13,HIGH);
+}
+
+// forward one complete kobuki feedback packet to linino ("FB" = "<count>:<hex>")
+void ReadFeedback() {
+  while (m_serial.available() > 0 && rx_len < RX_BUF_SIZE) {
+    rx_buf[rx_len++] = m_serial.read();
+  }
+
+  // drop bytes before the header
+  int start = 0;
+  while (start + 1 < rx_len && !(rx_buf[start] == 0xAA && rx_buf[start + 1] == 0x55)) {
+    start++;
+  }
+  if (start > 0) {
+    memmove(rx_buf, rx_buf + start, rx_len - start);
+    rx_len -= start;
+  }
+  if (rx_len < 3) {
+    return;
+  }
+
+  int packet_len = rx_buf[2] + 4; // header(2) + length(1) + payload + crc(1)
+  if (packet_len > RX_BUF_SIZE) {
+    rx_len = 0;
+    return;
+  }
+  if (rx_len < packet_len) {
+    return;
+  }
+
+  const char hex[] = "0123456789ABCDEF";
+  int pos = 0;
+  fb_count++;
+  fb_buf[pos++] = hex[fb_count >> 4];
+  fb_buf[pos++] = hex[fb_count & 0x0F];
+  fb_buf[pos++] = ':';
+  for (int i = 0; i < packet_len; i++) {
+    fb_buf[pos++] = hex[rx_buf[i] >> 4];
+    fb_buf[pos++] = hex[rx_buf[i] & 0x0F];
+  }
+  fb_buf[pos] = '\0';
+  Bridge.put("FB", fb_buf);
+
+  memmove(rx_buf, rx_buf + packet_len, rx_len - packet_len);
+  rx_len -= packet_len;
+}
+
+void loop() {
+  // SoftwareSerial keeps only 64 bytes (~5ms at 115200 baud), so drain it on every pass and never block in loop()
+  ReadFeedback();
+  if (millis() - command_ms < COMMAND_PERIOD_MS) {
+    return;
+  }
+  command_ms = millis();
+
+  // put your main code here, to run repeatedly:
+  memset(buf, 0, 100);
+  int buf_len = Bridge.get("D13",buf,100);
+  //struct SpeedMessageFormat *temp = (struct SpeedMessageFormat *)buf;
+  ReadFeedback();
+    
+  if (buf[0] != '0') {
+    if (digitalRead(13) == HIGH) digitalWrite(13, LOW);
+    else digitalWrite(13, HIGH);
+    m_serial.write(buf, buf_len);
+    //Serial.print(timer);
+    //Serial.print(": ");
+    //Serial.println((int16_t)temp->speed);
+    //Serial.write((char *)buf, buf_len);
+    //m_serial.write((char *)buf, buf_len);
+    //Bridge.put("D13", "0");
+  }
+  else {
+    if (digitalRead(13) == HIGH) digitalWrite(13, LOW);
+    else digitalWrite(13, HIGH);
+    m_serial.write(speed_stop, sizeof(speed_stop)/sizeof(byte));
+    //Serial.println("command stop");
+  }
+  return;
+}
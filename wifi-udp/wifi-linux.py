@@ -1,22 +1,308 @@
 import socket
+import struct
+import select
+import signal
+import heapq
+import argparse
 import time
-from bridgeclient import BridgeClient
+import math
+import random
+import datetime
 
-bridge = BridgeClient()
+# reliable header (src/kobuki.h - struct ReliableHeader)
+RELIABLE_MAGIC = 0x4B
+FRAME_TYPE_COMMAND = 1
+FRAME_TYPE_ACK = 2
+FRAME_TYPE_TIMED_COMMAND = 3
+FRAME_TYPE_SYNC_REQUEST = 4
+FRAME_TYPE_SYNC_RESPONSE = 5
+FRAME_TYPE_FEEDBACK = 6
+HEADER_FORMAT = '<BBHHH'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+EXEC_TIME_FORMAT = '<I'
+EXEC_TIME_SIZE = struct.calcsize(EXEC_TIME_FORMAT)
+SYNC_FORMAT = '<III'
+SYNC_SIZE = struct.calcsize(SYNC_FORMAT)
+SUB_PAYLOAD_ID_OFFSET = 3
+MAX_HOLD_US = 2000000
+REQUEST_EXTRA_ID = 0x09
+FEEDBACK_POLL_INTERVAL = 0.02
+BASIC_SENSOR_FORMAT = '<BBHBBBHHbbBBBB'
+INERTIAL_SENSOR_FORMAT = '<BBhhBBB'
+BUMPER_HOLD = 0.5
+TICK_MM = 0.085292
+BASE_CONTROL_ID = 0x01
+STOP_FRAME = '\xAA\x55\x06\x01\x04\x00\x00\x00\x00\x03'
+
+parser = argparse.ArgumentParser(description='kobuki wifi udp bridge')
+parser.add_argument('--ip', default='192.168.240.1')
+parser.add_argument('--port', type=int, default=5555)
+parser.add_argument('--local', action='store_true', help='run without the arduino bridge and report the timing of applied frames')
+parser.add_argument('--bumper-at', type=float, default=None, help='local mode: stream basic sensor feedback and press the central bumper this many seconds after the first command')
+parser.add_argument('--odometry', default=None, metavar='WHEEL_BASE_MM,SPEED_GAIN,LATENCY_MS', help='local mode: simulate the base with these true values and stream encoder and gyro feedback, e.g. 230,1.0,0')
+parser.add_argument('--loss', type=float, default=0.0, help='drop this percentage of received and sent udp frames, to test the driver on a lossy link')
+parser.add_argument('--outage-at', type=float, default=None, help='drop every udp frame from this many seconds after the first command')
+parser.add_argument('--outage-for', type=float, default=2.0, help='length of the --outage-at outage in seconds')
+parser.add_argument('--watchdog', type=int, default=0, help='stop kobuki when no frame arrives from the driver for this many ms, 0: disable')
+args = parser.parse_args()
+
+class Odometry(object):
+        # integrates the applied base control commands into wheel encoders and a gyro angle
+        def __init__(self, spec):
+                self.wheel_base, self.speed_gain, latency_ms = [float(x) for x in spec.split(',')]
+                self.latency = latency_ms / 1000.0
+                self.left = 0.0
+                self.right = 0.0
+                self.theta = 0.0
+                self.speed = 0
+                self.radius = 0
+                self.pending = []
+                self.time = time.time()
+
+        def command(self, frame):
+                speed, radius = struct.unpack('<hh', frame[5:9])
+                self.pending.append((time.time() + self.latency, speed, radius))
+
+        def integrate(self, t):
+                dt = max(0.0, t - self.time)
+                self.time = max(self.time, t)
+                v = self.speed * self.speed_gain
+                if self.radius == 0:
+                        left, right = v, v
+                elif abs(self.radius) == 1:
+                        left, right = -v, v
+                else:
+                        left = v * (self.radius - self.wheel_base / 2) / self.radius
+                        right = v * (self.radius + self.wheel_base / 2) / self.radius
+                self.left += left * dt
+                self.right += right * dt
+                self.theta += (right - left) / self.wheel_base * dt
+
+        def sensors(self):
+                now = time.time()
+                while self.pending and self.pending[0][0] <= now:
+                        at, speed, radius = self.pending.pop(0)
+                        self.integrate(at)
+                        self.speed, self.radius = speed, radius
+                self.integrate(now)
+                angle = int(round(math.degrees(self.theta) * 100))
+                return int(self.left / TICK_MM) & 0xFFFF, int(self.right / TICK_MM) & 0xFFFF, (angle + 18000) % 36000 - 18000
+
+class LocalBridge(object):
+        # stands in for the arduino and kobuki, answers request extra with version feedback
+        def __init__(self):
+                self.values = {}
+                self.count = 0
+                self.start_time = None
+                self.unread = False
+                self.odometry = Odometry(args.odometry) if args.odometry else None
+
+        def set_feedback(self, payload):
+                crc = len(payload)
+                for x in payload:
+                        crc ^= ord(x)
+                packet = '\xAA\x55' + chr(len(payload)) + payload + chr(crc)
+                self.count = (self.count + 1) & 0xFF
+                self.values["FB"] = '%02X:' % self.count + ''.join('{:02X}'.format(ord(x)) for x in packet)
+                self.unread = True
+
+        def put(self, key, value):
+                if key != "D13":
+                        return
+                if self.start_time is None:
+                        self.start_time = time.time()
+                if self.odometry and len(value) >= 9 and ord(value[SUB_PAYLOAD_ID_OFFSET]) == BASE_CONTROL_ID:
+                        self.odometry.command(value)
+                if len(value) > SUB_PAYLOAD_ID_OFFSET and ord(value[SUB_PAYLOAD_ID_OFFSET]) == REQUEST_EXTRA_ID:
+                        self.set_feedback('\x0A\x04\x00\x00\x01\x00' + '\x0B\x04\x05\x02\x01\x00')
+
+        def get(self, key):
+                # basic sensor stream, one packet per poll like the 50Hz kobuki feedback
+                if key == "FB" and (args.bumper_at is not None or self.odometry) and self.start_time is not None and not self.unread:
+                        elapsed = time.time() - self.start_time
+                        bumper = 0x02 if args.bumper_at is not None and args.bumper_at <= elapsed < args.bumper_at + BUMPER_HOLD else 0x00
+                        left, right, angle = self.odometry.sensors() if self.odometry else (0, 0, 0)
+                        payload = struct.pack(BASIC_SENSOR_FORMAT, 0x01, 15, int(elapsed * 1000) & 0xFFFF, bumper, 0, 0, left, right, 0, 0, 0, 0, 160, 0)
+                        if self.odometry:
+                                payload += struct.pack(INERTIAL_SENSOR_FORMAT, 0x04, 7, angle, 0, 0, 0, 0)
+                        self.set_feedback(payload)
+                if key == "FB":
+                        self.unread = False
+                return self.values.get(key)
+
+if args.local:
+        bridge = LocalBridge()
+else:
+        from bridgeclient import BridgeClient
+        bridge = BridgeClient()
+
+def terminate(signum, frame):
+        raise KeyboardInterrupt
+signal.signal(signal.SIGTERM, terminate)
 
 print("Initialize wifi udp bridge")
 
 sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-sock.bind(("192.168.240.1", 5555))
+sock.bind((args.ip, args.port))
+
+session = None
+driver_addr = None
+feedback_value = None
+feedback_poll_time = 0.0
+feedback_seq = 0
+epochs = {}
+applied_epochs = {}
+pending = []
+pending_order = 0
+late_samples = []
+first_command_time = None
+last_rx_time = None
+watchdog_fired = False
+dropped = 0
+
+def link_down():
+        # --loss and --outage-at stand in for a lossy wifi link
+        global dropped
+        outage = (args.outage_at is not None and first_command_time is not None and
+                  args.outage_at <= time.time() - first_command_time < args.outage_at + args.outage_for)
+        if outage or (args.loss > 0 and random.random() * 100 < args.loss):
+                dropped += 1
+                return True
+        return False
+
+def send(msg, addr):
+        if not link_down():
+                sock.sendto(msg, addr)
+
+def now_us():
+        return int(time.time() * 1000000) & 0xFFFFFFFF
+
+def signed32(value):
+        value &= 0xFFFFFFFF
+        if value >= 0x80000000:
+                value -= 0x100000000
+        return value
+
+def is_newer(epoch, last):
+        diff = (epoch - last) & 0xFFFF
+        return diff != 0 and diff < 0x8000
+
+def apply_frame(sub_payload_id, epoch, payload, exec_time):
+        if sub_payload_id in applied_epochs and not is_newer(epoch, applied_epochs[sub_payload_id]):
+                return
+        applied_epochs[sub_payload_id] = epoch
+        bridge.put("D13", payload)
+        if exec_time is not None:
+                late_samples.append(signed32(now_us() - exec_time))
+        print '[', datetime.datetime.now(), '] ', ''.join('{:02X}'.format(ord(x)) for x in payload)
+
+def poll_feedback():
+        global feedback_value, feedback_seq
+
+        # "FB" = "<count>:<hex>", written by the arduino for every kobuki feedback packet
+        value = bridge.get("FB")
+        if not value or value == feedback_value:
+                return
+        feedback_value = value
+        if driver_addr is None or ':' not in value:
+                return
+        packet = value.split(':', 1)[1].decode('hex')
+        feedback_seq = (feedback_seq + 1) & 0xFFFF
+        send(struct.pack(HEADER_FORMAT, RELIABLE_MAGIC, FRAME_TYPE_FEEDBACK, session, feedback_seq, 0) + packet, driver_addr)
+
+def handle_frame(msg, addr):
+        global session, driver_addr, epochs, applied_epochs, pending_order
+
+        magic, frame_type, msg_session, seq, epoch = struct.unpack(HEADER_FORMAT, msg[:HEADER_SIZE])
+        driver_addr = addr
+        if frame_type == FRAME_TYPE_SYNC_REQUEST and len(msg) >= HEADER_SIZE + SYNC_SIZE:
+                t2 = now_us()
+                t1, _, _ = struct.unpack(SYNC_FORMAT, msg[HEADER_SIZE:HEADER_SIZE + SYNC_SIZE])
+                response = struct.pack(HEADER_FORMAT, RELIABLE_MAGIC, FRAME_TYPE_SYNC_RESPONSE, msg_session, seq, 0)
+                send(response + struct.pack(SYNC_FORMAT, t1, t2, now_us()), addr)
+                return
+
+        exec_time = None
+        payload = msg[HEADER_SIZE:]
+        if frame_type == FRAME_TYPE_TIMED_COMMAND:
+                exec_time, = struct.unpack(EXEC_TIME_FORMAT, payload[:EXEC_TIME_SIZE])
+                payload = payload[EXEC_TIME_SIZE:]
+        elif frame_type != FRAME_TYPE_COMMAND:
+                return
+        if len(payload) <= SUB_PAYLOAD_ID_OFFSET:
+                return
+        sub_payload_id = ord(payload[SUB_PAYLOAD_ID_OFFSET])
+
+        # ack first, the bridge put below is slow
+        send(struct.pack(HEADER_FORMAT + 'B', RELIABLE_MAGIC, FRAME_TYPE_ACK, msg_session, seq, epoch, sub_payload_id), addr)
+
+        if msg_session != session:
+                session = msg_session
+                epochs = {}
+                applied_epochs = {}
+                del pending[:]
+        # retransmission or late frame of an older state
+        if sub_payload_id in epochs and not is_newer(epoch, epochs[sub_payload_id]):
+                return
+        epochs[sub_payload_id] = epoch
+
+        if exec_time is not None:
+                wait_us = signed32(exec_time - now_us())
+                if 0 < wait_us < MAX_HOLD_US:
+                        pending_order += 1
+                        heapq.heappush(pending, (time.time() + wait_us / 1000000.0, pending_order, sub_payload_id, epoch, payload, exec_time))
+                        return
+        apply_frame(sub_payload_id, epoch, payload, exec_time)
 
 while True:
         try:
-                msg = sock.recv(1024)
-                if msg:
+                timeout = FEEDBACK_POLL_INTERVAL
+                if pending:
+                        timeout = min(timeout, max(0.0, pending[0][0] - time.time()))
+                readable, _, _ = select.select([sock], [], [], timeout)
+
+                if time.time() - feedback_poll_time >= FEEDBACK_POLL_INTERVAL:
+                        feedback_poll_time = time.time()
+                        poll_feedback()
+
+                while pending and pending[0][0] <= time.time():
+                        _, _, sub_payload_id, epoch, payload, exec_time = heapq.heappop(pending)
+                        apply_frame(sub_payload_id, epoch, payload, exec_time)
+
+                # the driver sends keepalives, silence means the link or the driver is gone
+                if args.watchdog > 0 and last_rx_time is not None and not watchdog_fired and time.time() - last_rx_time > args.watchdog / 1000.0:
+                        watchdog_fired = True
+                        del pending[:]
+                        bridge.put("D13", STOP_FRAME)
+                        print '[', datetime.datetime.now(), '] watchdog stop, no frame for %dms' % args.watchdog
+
+                if not readable:
+                        continue
+                msg, addr = sock.recvfrom(1024)
+                if not msg:
+                        continue
+                if first_command_time is None:
+                        first_command_time = time.time()
+                if link_down():
+                        continue
+                last_rx_time = time.time()
+                watchdog_fired = False
+                if ord(msg[0]) == RELIABLE_MAGIC and len(msg) >= HEADER_SIZE:
+                        handle_frame(msg, addr)
+                else:
                         bridge.put("D13", msg)
-                print '[', datetime.datetime.now(), '] ', ''.join('{:02X}'.format(ord(x)) for x in msg)
+                        print '[', datetime.datetime.now(), '] ', ''.join('{:02X}'.format(ord(x)) for x in msg)
         except KeyboardInterrupt:
                 break
         except Exception as err:
                 print err
                 pass
+
+if dropped:
+        print 'dropped frames: %d' % dropped
+if args.local and bridge.odometry:
+        bridge.odometry.sensors()
+        print 'odometry: left %.1fmm, right %.1fmm, angle %.1fdeg' % (bridge.odometry.left, bridge.odometry.right, math.degrees(bridge.odometry.theta))
+if late_samples:
+        late_abs = sorted(abs(x) for x in late_samples)
+        print 'timed frames: %d, late mean: %dus, late p50: %dus, late max: %dus' % (len(late_samples), sum(late_samples) / len(late_samples), late_abs[len(late_abs) / 2], late_abs[-1])